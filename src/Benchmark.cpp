@@ -0,0 +1,328 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include "Benchmark.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+#include "PerfCounter.h"
+#include "render/Tile.h"
+#include "render/Sampler.h"
+#include "render/WavefrontRenderer.h"
+
+using std::cout;
+
+static double timeRender(SceneBuilder& builder) {
+    auto start = std::chrono::steady_clock::now();
+    builder.renderScene(false);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Prints a count with thousands grouping, "n/a" when the counter is unavailable
+static std::string formatCount(long long count) {
+    if(count < 0) {
+        return "n/a";
+    }
+    std::string digits = std::to_string(count);
+    std::string grouped;
+    for(size_t i = 0; i < digits.size(); ++i) {
+        if(i > 0 && (digits.size() - i) % 3 == 0) {
+            grouped += ',';
+        }
+        grouped += digits[i];
+    }
+    return grouped;
+}
+
+// Renders one camera with the given sampler and samples per pixel without writing it
+static std::vector<Radiance> renderCamera(SceneBuilder& builder, const Camera& camera, SamplerType sampler, int samples_per_pixel) {
+    RenderOptions options = builder.getOptions();
+    options.sampler = sampler;
+    builder.setOptions(options);
+    builder.setAntiAliasing(samples_per_pixel);
+
+    Progress progress(0, true);
+    std::vector<Radiance> pixels;
+    builder.renderTiles(camera, makeTiles(camera.h_res, camera.v_res), pixels, progress);
+    return pixels;
+}
+
+// Root mean square error over all channels of the displayed images, in 0-255 units
+static double rmse(const std::vector<Radiance>& image, const std::vector<Radiance>& reference) {
+    double sum = 0;
+    for(size_t i = 0; i < image.size(); ++i) {
+        double dr = displayed(image[i].r) - displayed(reference[i].r);
+        double dg = displayed(image[i].g) - displayed(reference[i].g);
+        double db = displayed(image[i].b) - displayed(reference[i].b);
+        sum += dr * dr + dg * dg + db * db;
+    }
+    return image.empty() ? 0 : std::sqrt(sum / (3.0 * image.size()));
+}
+
+void reportScaling(SceneBuilder& builder) {
+    const CpuTopology& topology = CpuTopology::get();
+    const RenderOptions& options = builder.getOptions();
+    unsigned int max_threads = options.threads ? options.threads : std::max(1, topology.cpuCount());
+
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    cout << "\nScaling report (" << topology.cpuCount() << " CPUs on " << topology.nodeCount() << " NUMA node(s), affinity "
+         << affinityPolicyName(options.affinity) << (options.replicate_geometry ? ", replicated geometry" : "") << ")\n";
+    cout << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << "\n";
+
+    double base_time = 0;
+    for (unsigned int threads : thread_counts) {
+        ThreadPool::configure(threads, options.affinity);
+        double seconds = timeRender(builder);
+        if (base_time == 0) {
+            base_time = seconds;
+        }
+        double speedup = base_time / seconds;
+        cout << std::setw(8) << threads
+             << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+             << std::setw(10) << std::setprecision(2) << speedup
+             << std::setw(11) << std::setprecision(0) << 100.0 * speedup / threads << "%\n";
+    }
+    cout << std::defaultfloat;
+
+    // Leave the pool as the command line asked for
+    ThreadPool::configure(options.threads, options.affinity);
+}
+
+void reportTileOrders(SceneBuilder& builder) {
+    RenderOptions options = builder.getOptions();
+    const TileOrder orders[] = {TileOrder::Scanline, TileOrder::Morton, TileOrder::Hilbert};
+
+    cout << "\nTile order report\n";
+    cout << std::setw(10) << "order" << std::setw(12) << "seconds" << std::setw(14) << "Mrays/s" << std::setw(10) << "speedup"
+         << std::setw(18) << "LLC misses" << std::setw(14) << "misses/ray" << "\n";
+
+    double base_rate = 0;
+    for(TileOrder order : orders) {
+        RenderOptions run_options = options;
+        run_options.tile_order = order;
+        builder.setOptions(run_options);
+
+        // The counter only follows threads created after it, so the pool is rebuilt
+        PerfCounter misses(PerfCounter::LastLevelCacheMisses);
+        ThreadPool::configure(options.threads, options.affinity);
+        misses.start();
+        RenderSummary summary = builder.renderScene(false);
+        long long miss_count = misses.stop();
+
+        double rate = summary.stats.rays() / summary.seconds;
+        if(base_rate == 0) {
+            base_rate = rate;
+        }
+        cout << std::setw(10) << tileOrderName(order)
+             << std::setw(12) << std::fixed << std::setprecision(3) << summary.seconds
+             << std::setw(14) << rate / 1e6
+             << std::setw(10) << std::setprecision(2) << rate / base_rate
+             << std::setw(18) << formatCount(miss_count)
+             << std::setw(14) << std::setprecision(4);
+        if(miss_count >= 0) {
+            cout << static_cast<double>(miss_count) / summary.stats.rays();
+        }
+        else {
+            cout << "n/a";
+        }
+        cout << "\n";
+    }
+    cout << std::defaultfloat;
+
+    builder.setOptions(options);
+}
+
+void reportRays(SceneBuilder& builder) {
+    RenderSummary summary = builder.renderScene(true);
+    const RenderStats& stats = summary.stats;
+    double per_primary = stats.primary_rays > 0 ? 1.0 / stats.primary_rays : 0;
+
+    cout << "\nRay report (" << builder.getScene().lights.size() << " lights, max depth " << builder.getScene().max_raytracedepth << ")\n";
+    cout << std::setw(12) << "kind" << std::setw(18) << "rays" << std::setw(14) << "per primary" << "\n";
+    auto row = [&](const char* kind, long long count) {
+        cout << std::setw(12) << kind << std::setw(18) << formatCount(count)
+             << std::setw(14) << std::fixed << std::setprecision(3) << count * per_primary << "\n";
+    };
+    row("primary", stats.primary_rays);
+    row("reflection", stats.reflection_rays);
+    row("shadow", stats.shadow_rays);
+    row("total", stats.rays());
+    cout << std::defaultfloat << "Throughput: " << std::fixed << std::setprecision(2) << stats.rays() / summary.seconds / 1e6
+         << " Mrays/s in " << std::setprecision(3) << summary.seconds << "s\n" << std::defaultfloat;
+
+    if(stats.shadow_cache_lookups > 0) {
+        // Same render without the cache for the speedup
+        RenderOptions options = builder.getOptions();
+        RenderOptions uncached = options;
+        uncached.shadow_cache = false;
+        builder.setOptions(uncached);
+        RenderSummary baseline = builder.renderScene(false);
+        builder.setOptions(options);
+
+        cout << "Shadow cache: " << formatCount(stats.shadow_cache_hits) << " hits in " << formatCount(stats.shadow_cache_lookups) << " lookups ("
+             << std::fixed << std::setprecision(1) << 100.0 * stats.shadow_cache_hits / stats.shadow_cache_lookups << "%), "
+             << std::setprecision(2) << baseline.seconds / summary.seconds << "x faster than without (" << std::setprecision(3) << baseline.seconds << "s)\n"
+             << std::defaultfloat;
+    }
+}
+
+void reportSamplers(SceneBuilder& builder, double target_rmse) {
+    static const int REFERENCE_SAMPLES = 256;
+    static const int MAX_SAMPLES = 64;
+    const SamplerType samplers[] = {SamplerType::Random, SamplerType::Stratified, SamplerType::Sobol, SamplerType::Halton, SamplerType::R2};
+
+    if(builder.getScene().cameras.empty()) {
+        return;
+    }
+    const Camera& camera = builder.getScene().cameras[0];
+    RenderOptions options = builder.getOptions();
+    int anti_aliasing = builder.getAntiAliasing();
+
+    // A 16x16 jittered grid per pixel is unbiased and close enough to converged
+    std::vector<Radiance> reference = renderCamera(builder, camera, SamplerType::Stratified, REFERENCE_SAMPLES);
+
+    cout << "\nSampler report (camera " << camera.image_name << ", reference " << REFERENCE_SAMPLES
+         << " spp, target RMSE " << target_rmse << ")\n";
+    cout << std::setw(12) << "sampler";
+    for(int spp = 1; spp <= MAX_SAMPLES; spp *= 2) {
+        cout << std::setw(9) << spp;
+    }
+    cout << std::setw(10) << "needed" << std::setw(10) << "speedup" << "\n";
+
+    int random_needed = 0;
+    for(SamplerType sampler : samplers) {
+        cout << std::setw(12) << samplerTypeName(sampler) << std::fixed << std::setprecision(3);
+        int needed = 0;
+        for(int spp = 1; spp <= MAX_SAMPLES; spp *= 2) {
+            double error = rmse(renderCamera(builder, camera, sampler, spp), reference);
+            if(needed == 0 && error <= target_rmse) {
+                needed = spp;
+            }
+            cout << std::setw(9) << error;
+        }
+        if(sampler == SamplerType::Random) {
+            random_needed = needed;
+        }
+
+        cout << std::setw(10) << (needed ? std::to_string(needed) : ">" + std::to_string(MAX_SAMPLES));
+        if(needed && random_needed) {
+            cout << std::setw(9) << std::setprecision(1) << static_cast<double>(random_needed) / needed << "x";
+        }
+        else {
+            cout << std::setw(10) << "-";
+        }
+        cout << "\n" << std::defaultfloat;
+    }
+
+    builder.setOptions(options);
+    builder.setAntiAliasing(anti_aliasing);
+}
+
+void reportPackets(SceneBuilder& builder) {
+    RenderOptions options = builder.getOptions();
+    struct Config {
+        int packet_size;
+        bool frustum;
+    };
+    const Config configs[] = {{1, false}, {4, false}, {4, true}, {8, false}, {8, true}, {16, false}, {16, true}};
+
+    cout << "\nPacket report\n";
+    cout << std::setw(8) << "packet" << std::setw(9) << "frustum" << std::setw(12) << "seconds" << std::setw(14) << "Mrays/s" << std::setw(10) << "speedup" << "\n";
+
+    double base_rate = 0;
+    for(const Config& config : configs) {
+        RenderOptions run_options = options;
+        run_options.packet_size = config.packet_size;
+        run_options.packet_frustum = config.frustum;
+        builder.setOptions(run_options);
+
+        RenderSummary summary = builder.renderScene(false);
+        double rate = summary.stats.rays() / summary.seconds;
+        if(base_rate == 0) {
+            base_rate = rate;
+        }
+        cout << std::setw(8) << config.packet_size << std::setw(9) << (config.packet_size == 1 ? "-" : config.frustum ? "on" : "off")
+             << std::setw(12) << std::fixed << std::setprecision(3) << summary.seconds
+             << std::setw(14) << rate / 1e6
+             << std::setw(10) << std::setprecision(2) << rate / base_rate << "\n" << std::defaultfloat;
+    }
+
+    builder.setOptions(options);
+}
+
+void reportWavefront(SceneBuilder& builder) {
+    RenderOptions options = builder.getOptions();
+
+    int batch = WavefrontRenderer(builder).batchSize();
+    cout << "\nWavefront report (batches of " << batch << "x" << batch << " pixels)\n";
+    cout << std::setw(12) << "renderer" << std::setw(12) << "seconds" << std::setw(14) << "rays" << std::setw(12) << "Mrays/s" << std::setw(10) << "speedup" << "\n";
+
+    double base_seconds = 0;
+    for(bool wavefront : {false, true}) {
+        RenderOptions run_options = options;
+        run_options.wavefront = wavefront;
+        builder.setOptions(run_options);
+
+        RenderSummary summary = builder.renderScene(false);
+        if(base_seconds == 0) {
+            base_seconds = summary.seconds;
+        }
+        cout << std::setw(12) << (wavefront ? "wavefront" : "recursive")
+             << std::setw(12) << std::fixed << std::setprecision(3) << summary.seconds
+             << std::setw(14) << formatCount(summary.stats.rays())
+             << std::setw(12) << summary.stats.rays() / summary.seconds / 1e6
+             << std::setw(10) << std::setprecision(2) << base_seconds / summary.seconds << "\n" << std::defaultfloat;
+    }
+
+    builder.setOptions(options);
+}
+
+void reportRaySorting(SceneBuilder& builder) {
+    RenderOptions options = builder.getOptions();
+
+    cout << "\nRay sorting report (reflection and shadow rays)\n";
+    cout << std::setw(8) << "sorting" << std::setw(12) << "seconds" << std::setw(14) << "rays" << std::setw(12) << "sort ms"
+         << std::setw(14) << "ns/ray" << std::setw(10) << "speedup" << "\n";
+
+    double base_ns = 0;
+    for(RaySortMode mode : {RaySortMode::Off, RaySortMode::On}) {
+        RenderOptions run_options = options;
+        run_options.ray_sort = mode;
+        run_options.quiet = true;
+        builder.setOptions(run_options);
+
+        WavefrontRenderer renderer(builder);
+        RenderSummary summary = renderer.renderScene(false);
+        WavefrontRenderer::SortStats stats = renderer.sortStats();
+        bool sorted = mode == RaySortMode::On;
+        double ns = stats.nsPerRay(sorted);
+        if(base_ns == 0) {
+            base_ns = ns;
+        }
+        cout << std::setw(8) << raySortModeName(mode)
+             << std::setw(12) << std::fixed << std::setprecision(3) << summary.seconds
+             << std::setw(14) << formatCount(stats.rays[sorted])
+             << std::setw(12) << std::setprecision(1) << stats.sort_ns / 1e6
+             << std::setw(14) << ns
+             << std::setw(10) << std::setprecision(2) << (ns > 0 ? base_ns / ns : 0) << "\n" << std::defaultfloat;
+    }
+
+    RenderOptions auto_options = options;
+    auto_options.ray_sort = RaySortMode::Auto;
+    auto_options.quiet = true;
+    builder.setOptions(auto_options);
+    WavefrontRenderer renderer(builder);
+    renderer.renderScene(false);
+    cout << "Auto mode: sorting " << (renderer.sortStats().sorting ? "on" : "off") << "\n";
+
+    builder.setOptions(options);
+}
@@ -0,0 +1,31 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include "SceneBuilder.h"
+
+// Renders every camera with 1, 2, 4, ... worker threads without writing images
+// and prints wall time, speedup and parallel efficiency for each thread count.
+void reportScaling(SceneBuilder& builder);
+
+// Renders every camera once per tile order and compares rays/s and last level cache misses
+void reportTileOrders(SceneBuilder& builder);
+
+// Renders and writes every camera, then prints how many rays of each kind were traced
+void reportRays(SceneBuilder& builder);
+
+// Renders the first camera with every sampler at 1, 2, 4, ... 64 samples per pixel and prints
+// the RMSE against a high sample count reference, and how many samples reach target_rmse
+void reportSamplers(SceneBuilder& builder, double target_rmse);
+
+// Renders every camera with single rays and with packets of 4, 8 and 16 rays (with and
+// without frustum culling) and prints rays/s relative to single rays
+void reportPackets(SceneBuilder& builder);
+
+// Renders every camera with the recursive and the wavefront renderer and compares time and rays/s
+void reportWavefront(SceneBuilder& builder);
+
+// Renders every camera with the wavefront renderer without and with ray sorting and prints
+// sorting cost and traversal time per reflection and shadow ray
+void reportRaySorting(SceneBuilder& builder);
+
+#endif
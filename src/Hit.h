@@ -13,6 +13,7 @@ struct Hit {
     Point hit_point;
     Vector normal;
     Material material;
+    int object = -1;    // Index of the object in the scene, set by SceneBuilder::intersect
 };
 
 #endif
\ No newline at end of file
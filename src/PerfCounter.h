@@ -0,0 +1,32 @@
+#ifndef _PERFCOUNTER_H
+#define _PERFCOUNTER_H
+
+#include <cstdint>
+
+// Hardware event counter for this process through perf_event_open (Linux).
+// Counts threads created after the counter was opened, so open it before
+// (re)configuring the thread pool. valid() is false where perf is unavailable,
+// e.g. in containers or with a strict perf_event_paranoid.
+class PerfCounter {
+public:
+    enum Event {
+        LastLevelCacheMisses,
+        Instructions
+    };
+
+    explicit PerfCounter(Event event);
+    ~PerfCounter();
+
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator =(const PerfCounter&) = delete;
+
+    bool valid() const;
+    void start();
+    // Events since start(), -1 if the counter is not valid
+    long long stop();
+
+private:
+    int fd;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include "Progress.h"
+
+Progress::Progress(long long total_pixels, bool quiet) : total_pixels(total_pixels), quiet(quiet), start_time(std::chrono::steady_clock::now()),
+        completed_pixels(0), completed_samples(0), primary_rays(0), shadow_rays(0), reflection_rays(0), shadow_cache_lookups(0), shadow_cache_hits(0), stopping(false), finished(false) {
+    if(!quiet) {
+        reporter = std::thread(&Progress::reporterLoop, this);
+    }
+}
+
+Progress::~Progress() {
+    finish();
+}
+
+void Progress::finish() {
+    if(finished) {
+        return;
+    }
+    finished = true;
+
+    if(reporter.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(stop_mutex);
+            stopping = true;
+        }
+        stop_cv.notify_all();
+        reporter.join();
+    }
+    if(!quiet) {
+        print(true);
+    }
+}
+
+long long Progress::rays() const {
+    return stats().rays();
+}
+
+long long Progress::samples() const {
+    return completed_samples.load(std::memory_order_relaxed);
+}
+
+RenderStats Progress::stats() const {
+    RenderStats s;
+    s.samples = completed_samples.load(std::memory_order_relaxed);
+    s.primary_rays = primary_rays.load(std::memory_order_relaxed);
+    s.shadow_rays = shadow_rays.load(std::memory_order_relaxed);
+    s.reflection_rays = reflection_rays.load(std::memory_order_relaxed);
+    s.shadow_cache_lookups = shadow_cache_lookups.load(std::memory_order_relaxed);
+    s.shadow_cache_hits = shadow_cache_hits.load(std::memory_order_relaxed);
+    return s;
+}
+
+double Progress::elapsedSeconds() const {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    return elapsed.count();
+}
+
+void Progress::reporterLoop() {
+    std::unique_lock<std::mutex> lock(stop_mutex);
+    while(!stop_cv.wait_for(lock, REPORT_INTERVAL, [this] { return stopping; })) {
+        print(false);
+    }
+}
+
+// Formats a rate with a k/M/G suffix
+static std::string humanRate(double per_second) {
+    const char* suffixes[] = {"", "k", "M", "G"};
+    int i = 0;
+    while(per_second >= 1000.0 && i < 3) {
+        per_second /= 1000.0;
+        ++i;
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2) << per_second << " " << suffixes[i];
+    return oss.str();
+}
+
+void Progress::print(bool final) {
+    double elapsed = elapsedSeconds();
+    long long pixels = completed_pixels.load(std::memory_order_relaxed);
+    double fraction = total_pixels > 0 ? static_cast<double>(pixels) / total_pixels : 1.0;
+
+    std::ostringstream line;
+    line << "\rProgress: " << static_cast<int>(100.0 * fraction) << "%";
+    if(final) {
+        line << " | " << std::fixed << std::setprecision(2) << elapsed << "s";
+    }
+    else if(fraction > 0) {
+        line << " | ETA " << std::fixed << std::setprecision(1) << elapsed * (1.0 - fraction) / fraction << "s";
+    }
+    if(elapsed > 0) {
+        line << " | " << humanRate(rays() / elapsed) << "rays/s"
+             << " | " << humanRate(samples() / elapsed) << "samples/s";
+    }
+    line << "   ";
+    if(final) {
+        line << "\n";
+    }
+
+    std::cerr << line.str() << std::flush;
+}
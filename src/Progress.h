@@ -0,0 +1,66 @@
+#ifndef _PROGRESS_H
+#define _PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "render/RenderStats.h"
+
+// Render progress shared by all workers.
+// Workers only do relaxed atomic adds, a single reporter thread formats and prints
+// percent done, ETA and throughput at a fixed interval.
+class Progress {
+public:
+    Progress(long long total_pixels, bool quiet);
+    ~Progress();
+
+    Progress(const Progress&) = delete;
+    Progress& operator =(const Progress&) = delete;
+
+    inline void add(long long pixels, const RenderStats& delta) {
+        completed_pixels.fetch_add(pixels, std::memory_order_relaxed);
+        completed_samples.fetch_add(delta.samples, std::memory_order_relaxed);
+        primary_rays.fetch_add(delta.primary_rays, std::memory_order_relaxed);
+        shadow_rays.fetch_add(delta.shadow_rays, std::memory_order_relaxed);
+        reflection_rays.fetch_add(delta.reflection_rays, std::memory_order_relaxed);
+        shadow_cache_lookups.fetch_add(delta.shadow_cache_lookups, std::memory_order_relaxed);
+        shadow_cache_hits.fetch_add(delta.shadow_cache_hits, std::memory_order_relaxed);
+    }
+
+    // Stops the reporter and prints the final totals
+    void finish();
+
+    long long rays() const;
+    long long samples() const;
+    RenderStats stats() const;
+    double elapsedSeconds() const;
+
+private:
+    void reporterLoop();
+    void print(bool final);
+
+    static constexpr std::chrono::milliseconds REPORT_INTERVAL{500};
+
+    long long total_pixels;
+    bool quiet;
+    std::chrono::steady_clock::time_point start_time;
+
+    std::atomic<long long> completed_pixels;
+    std::atomic<long long> completed_samples;
+    std::atomic<long long> primary_rays;
+    std::atomic<long long> shadow_rays;
+    std::atomic<long long> reflection_rays;
+    std::atomic<long long> shadow_cache_lookups;
+    std::atomic<long long> shadow_cache_hits;
+
+    std::thread reporter;
+    std::mutex stop_mutex;
+    std::condition_variable stop_cv;
+    bool stopping;
+    bool finished;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _RENDEROPTIONS_H
+#define _RENDEROPTIONS_H
+
+#include <string>
+
+#include "Topology.h"
+#include "render/Tile.h"
+#include "render/Sampler.h"
+#include "render/RaySort.h"
+
+// Settings given on the command line that are not part of the scene file
+struct RenderOptions {
+    unsigned int threads = 0;   // 0 = one per available CPU
+    AffinityPolicy affinity = AffinityPolicy::None;
+    bool replicate_geometry = false;
+    bool scaling_report = false;
+    bool quiet = false;         // No progress or throughput output
+    bool count_rays = true;     // Per-ray counters for the progress line and reports, off when nothing reads them
+    int workers = 0;            // Worker processes, 0 renders in this process
+    std::string daemon_socket;  // Serve render requests on this Unix socket when set
+    bool gbuffer_cache = false; // Daemon: keep primary hits, light and material edits re-render without camera rays
+    TileOrder tile_order = TileOrder::Scanline;
+    SamplerType sampler = SamplerType::Random;
+    Tile crop = {0, 0, 0, 0};   // Crop window for every camera, empty keeps the scene's
+    bool crop_fill = false;     // Write cropped renders as full size images, black outside the window
+    bool order_report = false;
+    bool ray_report = false;
+    bool shadow_cache = true;   // Test the last occluder per light and thread before traversing
+    double reflection_cutoff = 1e-3;  // Stop mirror rays whose path throughput falls below this
+    bool russian_roulette = false;    // Continue paths below the cutoff randomly instead, unbiased
+    int light_samples = 0;      // > 0 shades this many lights per hit, picked by importance
+    double light_cutoff = 0;    // Skip lights whose intensity / d^2 is below this, 0 = every light
+    int packet_size = 1;        // Primary rays traced together: 1 (single rays), 4, 8 or 16
+    bool packet_frustum = true; // Interval frustum culling of BVH nodes for packets
+    bool packet_report = false;
+    bool wavefront = false;     // Render with ray queues and batched kernels instead of recursion
+    bool wavefront_report = false;
+    RaySortMode ray_sort = RaySortMode::Auto;   // Wavefront: sort reflection and shadow queues before traversal
+    bool sort_report = false;
+    bool sampler_report = false;
+    double target_rmse = 0.5;   // 0-255 units, for the sampler report
+    bool edge_aa = false;           // Supersample only pixels next to object, crease or depth edges and mirrors
+    double adaptive_threshold = 0;  // > 0 enables adaptive sampling: target standard error of the pixel luminance (0-255)
+    int min_spp = 8;            // Adaptive sampling batch size
+    int max_spp = 64;
+    int progressive_passes = -1;    // >= 0 renders progressively, 0 = until interrupted
+    double flush_seconds = 10;  // Progressive image writes, 0 disables either trigger
+    int flush_passes = 0;
+    bool preview = false;       // Render at 1/8, 1/4, 1/2 and full resolution, writing each level
+    double time_budget = 0;     // Seconds, > 0 renders the best image possible within the budget
+};
+
+#endif
@@ -1,14 +1,29 @@
 #include <fstream>
 #include <sstream>
-#include <random>
 #include <memory>
 #include <vector>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
 
 #include "SceneBuilder.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+#include "Progress.h"
+
+#include "render/Tile.h"
+#include "render/RenderJob.h"
+#include "render/RenderStats.h"
+#include "render/ImageWriter.h"
+#include "render/RayGenerator.h"
+#include "render/Sampler.h"
+#include "render/Random.h"
+#include "render/Accumulator.h"
+#include "render/WavefrontRenderer.h"
 #include "Vector.h"
 
 #include "scene/Scene.h"
@@ -36,6 +51,7 @@ SceneBuilder::SceneBuilder(char* filename) {
 }
 
 SceneBuilder::~SceneBuilder() {
+    releaseReplicas();
     for(auto it = scene.objects.begin(); it != scene.objects.end(); ++it) {
         delete* it;
     }
@@ -51,6 +67,7 @@ void SceneBuilder::importScene(char* filename) {
     
     // Call parseScene to handle all
     parseScene(xmlDoc);
+    buildLightBVH();
 }
 
 void SceneBuilder::setAntiAliasing(int n) {
@@ -61,99 +78,528 @@ int SceneBuilder::getAntiAliasing() {
     return anti_aliasing;
 }
 
+void SceneBuilder::setOptions(const RenderOptions& o) {
+    bool lights_changed = o.light_cutoff != options.light_cutoff || (o.light_samples > 0) != (options.light_samples > 0);
+    options = o;
+    if (lights_changed) {
+        buildLightBVH();
+    }
+}
+
+const RenderOptions& SceneBuilder::getOptions() {
+    return options;
+}
+
+const Scene& SceneBuilder::getScene() const {
+    return scene;
+}
+
 RGB convert(Color c) {
     return RGB(static_cast<short>(c.x() * 255), static_cast<short>(c.y() * 255), static_cast<short>(c.z() * 255));
 }
 
-double generate_random_double() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_real_distribution<> dis(0.0, 1.0);
-    return dis(gen);
+// Mean color of one pixel. Uniform sampling takes anti_aliasing samples. Adaptive sampling takes
+// min_spp at a time until the standard error of the luminance drops below the threshold or
+// max_spp is reached. The number of samples taken is returned in samples.
+static Color samplePixel(SceneBuilder* builder, const RayGenerator& rays, const Sampler& sampler, int i, int j, int& samples) {
+    const RenderOptions& options = builder->getOptions();
+
+    if(options.adaptive_threshold <= 0) {
+        int count = builder->getAntiAliasing();
+        Color color(0, 0, 0);
+        for(int k = 0; k < count; ++k) {
+            double u, v;
+            sampler.sample(i, j, k, count, u, v);
+            color += builder->sample(rays, i + u, j + v).color();
+        }
+        samples = count;
+        return color / count;
+    }
+
+    int batch = std::max(1, options.min_spp);
+    int max_spp = std::max(batch, options.max_spp);
+    PixelEstimate estimate;
+    while(estimate.samples < max_spp) {
+        int count = std::min(batch, max_spp - estimate.samples);
+        // Round indices continue the pixel's sequence, k runs over the round's batch
+        const int first = estimate.samples;
+        for(int k = 0; k < count; ++k) {
+            double u, v;
+            sampler.sample(i, j, first + k, count, u, v);
+            estimate.add(builder->sample(rays, i + u, j + v));
+        }
+        if(std::sqrt(estimate.variance() / estimate.samples) <= options.adaptive_threshold) {
+            break;
+        }
+    }
+    samples = estimate.samples;
+    return estimate.sum / samples;
+}
+
+// Traces the pixels of a tile in blocks of packet_size rays (2x2, 4x2 or 4x4), one packet per sample
+void renderTilePackets(SceneBuilder* builder, const RayGenerator& rays, const Sampler& sampler, const Tile& tile, Framebuffer& buffer) {
+    const int packet_size = builder->getOptions().packet_size;
+    const int block_w = packet_size >= 8 ? 4 : 2;
+    const int block_h = packet_size / block_w;
+    const int count = builder->getAntiAliasing();
+    RenderStats& stats = localStats();
+
+    for(const auto& [dx, dy] : tilePixelOrder(builder->getOptions().tile_order)) {
+        // Blocks follow the tile order by their top left pixel
+        if(dx % block_w != 0 || dy % block_h != 0 || tile.x0 + dx >= tile.x1 || tile.y0 + dy >= tile.y1) {
+            continue;
+        }
+
+        int xs[MAX_PACKET_SIZE], ys[MAX_PACKET_SIZE];
+        int pixels = 0;
+        for(int by = 0; by < block_h; ++by) {
+            for(int bx = 0; bx < block_w; ++bx) {
+                if(tile.x0 + dx + bx < tile.x1 && tile.y0 + dy + by < tile.y1) {
+                    xs[pixels] = tile.x0 + dx + bx;
+                    ys[pixels] = tile.y0 + dy + by;
+                    pixels++;
+                }
+            }
+        }
+
+        Color sums[MAX_PACKET_SIZE];
+        for(int k = 0; k < count; ++k) {
+            RayPacket packet;
+            for(int p = 0; p < pixels; ++p) {
+                double u, v;
+                sampler.sample(xs[p], ys[p], k, count, u, v);
+                packet.add(rays.at(xs[p] + u, ys[p] + v), INF);
+            }
+            packet.finish(builder->getOptions().packet_frustum);
+            Radiance colors[MAX_PACKET_SIZE];
+            builder->tracePacket(packet, colors);
+            for(int p = 0; p < pixels; ++p) {
+                sums[p] += colors[p].color();
+            }
+        }
+        if(builder->options.count_rays) {
+            stats.samples += static_cast<long long>(count) * pixels;
+        }
+
+        for(int p = 0; p < pixels; ++p) {
+            buffer.set(xs[p], ys[p], Radiance(sums[p] / count));
+        }
+    }
+}
+
+// Neighbouring center hits on one object are an edge past these
+static const double EDGE_NORMAL_COS = 0.9;
+static const double EDGE_DEPTH_RATIO = 0.1;
+
+// What the center ray of a pixel hit, compared between neighbours to find edges
+struct PrimaryHit {
+    int object;         // -2 for background, -1 outside the image
+    double t;
+    Vector normal;
+    bool mirror;
+    uint64_t lit;       // Signature of the set of lights that reach the hit, 0 for none
+};
+
+// Brightest channel of a light, used for its radius and sampling importance
+static double lightPower(const PointLight& light) {
+    return std::max({light.intensity.x(), light.intensity.y(), light.intensity.z(), 0.0});
 }
 
-void renderChunk(SceneBuilder* builder, const Camera& camera, int start, int end, std::vector<RGB>& buffer, std::mutex& buffer_mutex, std::atomic<int>& completed_scanlines, int total_scanlines, std::mutex& cerr_mutex) {
-    Vector w = camera.gaze;
-    Vector u = (camera.up * w).normalize();
-    Vector v = w * u;
+// Order independent signature of a set of lights, equal sets always compare equal
+static uint64_t lightSignature(size_t light) {
+    uint64_t z = light + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (z ^ (z >> 31)) | 1;
+}
+
+static bool isEdge(const PrimaryHit& a, const PrimaryHit& b) {
+    if(a.object != b.object) {
+        return true;
+    }
+    if(a.object < 0) {
+        return false;
+    }
+    // Shadow boundaries, creases between faces of a mesh and self occlusion within one object
+    return a.lit != b.lit || a.normal.dot(b.normal) < EDGE_NORMAL_COS || std::abs(a.t - b.t) > EDGE_DEPTH_RATIO * std::min(a.t, b.t);
+}
 
-    double aspect_ratio = static_cast<double>(camera.h_res) / camera.v_res;
-    double image_plane_width = camera.right - camera.left;
-    double image_plane_height = (camera.top - camera.bottom) / aspect_ratio;
+// Traces one center ray per pixel of the tile and of the ring around it, then spends
+// anti_aliasing samples only on pixels next to an object, shadow, crease or depth edge or
+// showing a mirror. Every other pixel keeps its center sample.
+void renderTileEdges(SceneBuilder* builder, const RayGenerator& rays, const Sampler& sampler, const Tile& tile, Framebuffer& buffer, unsigned short* sample_counts) {
+    const Camera& camera = rays.getCamera();
+    const size_t num_lights = builder->scene.lights.size();
+    const int w = tile.width() + 2, h = tile.height() + 2;
+    // Every light that reaches a center hit is tested for the shadow boundary check and shading
+    // reuses the tests. With light sampling testing every light would cost more than the render,
+    // only the light_samples strongest by power / d^2 are tested and shading draws its own.
+    const bool reuse_shadows = !builder->samplingLights();
+    const size_t probed_lights = static_cast<size_t>(std::max(1, builder->options.light_samples));
+    std::vector<std::pair<double, int>> strongest;
+    RenderStats& stats = localStats();
+
+    std::vector<PrimaryHit> ids(static_cast<size_t>(w) * h);
+    std::vector<Hit> hits(static_cast<size_t>(tile.pixelCount()));
+    std::vector<unsigned char> visibility(reuse_shadows ? static_cast<size_t>(tile.pixelCount()) * num_lights : 0);
+    for(int y = 0; y < h; ++y) {
+        for(int x = 0; x < w; ++x) {
+            int i = tile.x0 + x - 1, j = tile.y0 + y - 1;
+            PrimaryHit& id = ids[static_cast<size_t>(y) * w + x];
+            id = PrimaryHit{-1, INF, Vector(), false, 0};
+            if(i < 0 || j < 0 || i >= static_cast<int>(camera.h_res) || j >= static_cast<int>(camera.v_res)) {
+                continue;
+            }
+            // Ring pixels belong to other tiles, outside pixels are never compared
+            bool inside = x > 0 && y > 0 && x < w - 1 && y < h - 1;
+            Hit hit;
+            if(builder->options.count_rays) {
+                stats.primary_rays++;
+            }
+            if(builder->intersect(rays.at(i + 0.5, j + 0.5), hit)) {
+                const Color& mirror = hit.material.mirror_reflectance;
+                id = PrimaryHit{hit.object, hit.t, hit.normal, mirror.x() > 0 || mirror.y() > 0 || mirror.z() > 0, 0};
+                unsigned char* visible = inside && reuse_shadows ? visibility.data() + (static_cast<size_t>(y - 1) * tile.width() + (x - 1)) * num_lights : nullptr;
+                auto probe = [&](int l) {
+                    if(builder->lightVisible(hit, l)) {
+                        id.lit += lightSignature(l);
+                        if(visible) {
+                            visible[l] = 1;
+                        }
+                    }
+                };
+                strongest.clear();
+                auto reached = [&](int l) {
+                    if(builder->lightReaches(l, hit.hit_point)) {
+                        if(reuse_shadows) {
+                            probe(l);
+                        }
+                        else {
+                            const PointLight& light = builder->scene.lights[l];
+                            strongest.emplace_back(lightPower(light) / std::max((light.position - hit.hit_point).length_sqr(), 1e-6), l);
+                        }
+                    }
+                    return false;
+                };
+                if(builder->options.light_cutoff > 0) {
+                    builder->light_bvh.query(hit.hit_point, reached);
+                }
+                else {
+                    for(size_t l = 0; l < num_lights; ++l) {
+                        reached(l);
+                    }
+                }
+                if(strongest.size() > probed_lights) {
+                    std::partial_sort(strongest.begin(), strongest.begin() + probed_lights, strongest.end(), std::greater<>());
+                    strongest.resize(probed_lights);
+                }
+                for(const auto& light : strongest) {
+                    probe(light.second);
+                }
+            }
+            else {
+                id.object = -2;
+            }
+            if(inside) {
+                hits[static_cast<size_t>(y - 1) * tile.width() + (x - 1)] = hit;
+            }
+        }
+    }
 
-    for(int j = start; j < end; ++j) {
-        for(int i = 0; i < camera.h_res; ++i) {
-            RGB color(0, 0, 0);
-            // Anti aliasing
-            for(int k = 0; k < builder->anti_aliasing; ++k) {
-                // Create a ray from camera to pixel
-                double u_offset = ((double)i + generate_random_double()) * image_plane_width / camera.h_res;
-                double v_offset = ((double)j + generate_random_double()) * image_plane_height / camera.v_res;
-                Point pixel_pos = camera.position + (w * camera.near_distance) + (u * (camera.left + u_offset)) + (v * (camera.bottom + v_offset));
+    for(const auto& [dx, dy] : tilePixelOrder(builder->options.tile_order)) {
+        int i = tile.x0 + dx;
+        int j = tile.y0 + dy;
+        if(i >= tile.x1 || j >= tile.y1) {
+            continue;
+        }
 
-                Ray ray(camera.position, (pixel_pos - camera.position).normalize());
-                // call trace for ray
-                color = color + builder->trace(ray, 0);
+        const PrimaryHit& center = ids[static_cast<size_t>(dy + 1) * w + (dx + 1)];
+        bool edge = center.mirror;
+        for(int ny = 0; ny < 3 && !edge; ++ny) {
+            for(int nx = 0; nx < 3 && !edge; ++nx) {
+                const PrimaryHit& neighbour = ids[static_cast<size_t>(dy + ny) * w + (dx + nx)];
+                edge = neighbour.object != -1 && isEdge(center, neighbour);
             }
-            color = color / builder->anti_aliasing;
+        }
 
-            // Store the result in the buffer
-            std::lock_guard<std::mutex> guard(buffer_mutex);
-            buffer[j * camera.h_res + i] = color;
+        int samples = 1;
+        Color color;
+        if(edge) {
+            // Same samples as uniform anti aliasing, the center ray only served as a probe
+            color = samplePixel(builder, rays, sampler, i, j, samples);
+        }
+        else {
+            const size_t p = static_cast<size_t>(dy) * tile.width() + dx;
+            Hit& hit = hits[p];
+            Ray ray = rays.at(i + 0.5, j + 0.5);
+            const unsigned char* visible = reuse_shadows ? visibility.data() + p * num_lights : nullptr;
+            color = (hit.is_hit() ? builder->shadeHit(ray, hit, 0, Color(1, 1, 1), visible) : builder->background()).color();
+        }
+        if(builder->options.count_rays) {
+            stats.samples += samples;
         }
 
-        // Update progress
-        completed_scanlines++;
-        {
-            std::lock_guard<std::mutex> guard(cerr_mutex);
-            int progress = static_cast<int>(100.0 * completed_scanlines / total_scanlines);
-            std::cerr << "\rProgress: " << progress << "%" << std::flush;
+        buffer.set(i, j, Radiance(color));
+        if(sample_counts) {
+            sample_counts[static_cast<size_t>(j) * camera.h_res + i] = samples;
         }
     }
 }
 
-void SceneBuilder::exportScene() {
-    std::ofstream out;
-    const int num_threads = std::thread::hardware_concurrency(); // Get the number of available threads
+void renderTile(SceneBuilder* builder, const Camera& camera, const Tile& tile, Framebuffer& buffer, Progress& progress, unsigned short* sample_counts) {
+    RenderStats& stats = localStats();
+    RenderStats before = stats;
+    RayGenerator rays(camera);
+    const Sampler& sampler = getSampler(builder->options.sampler);
+
+    // Adaptive sampling and edge anti aliasing decide per pixel, they always trace single rays
+    if(builder->edgeAntiAliasing()) {
+        renderTileEdges(builder, rays, sampler, tile, buffer, sample_counts);
+        progress.add(tile.pixelCount(), stats - before);
+        return;
+    }
+    if(builder->options.packet_size > 1 && builder->options.adaptive_threshold <= 0) {
+        renderTilePackets(builder, rays, sampler, tile, buffer);
+        progress.add(tile.pixelCount(), stats - before);
+        return;
+    }
+
+    for(const auto& [dx, dy] : tilePixelOrder(builder->options.tile_order)) {
+        int i = tile.x0 + dx;
+        int j = tile.y0 + dy;
+        if(i >= tile.x1 || j >= tile.y1) {
+            continue;
+        }
 
-    // For every camera, output an image
-    for (auto camera : scene.cameras) {
-        out.open(camera.image_name, std::ios::binary | std::ios::ate | std::ios::out);
+        // Anti aliasing
+        int samples = 0;
+        Color color = samplePixel(builder, rays, sampler, i, j, samples);
+        if(builder->options.count_rays) {
+            stats.samples += samples;
+        }
 
-        // ppm header
-        out << "P3" << "\n";
-        out << camera.h_res << " " << camera.v_res << "\n";
-        out << "255" << "\n";
+        // Tiles never overlap, no locking needed
+        buffer.set(i, j, Radiance(color));
+        if(sample_counts) {
+            sample_counts[static_cast<size_t>(j) * camera.h_res + i] = samples;
+        }
+    }
 
-        std::vector<RGB> buffer(camera.h_res * camera.v_res);
-        std::mutex buffer_mutex;
-        std::mutex cerr_mutex;
-        std::atomic<int> completed_scanlines(0);
-        int total_scanlines = camera.v_res;
+    progress.add(tile.pixelCount(), stats - before);
+}
 
-        // Determine the chunk size for each thread
-        int chunk_size = std::ceil(static_cast<double>(camera.v_res) / num_threads);
+Radiance SceneBuilder::sample(const RayGenerator& rays, double x, double y) {
+    // Create a ray from camera to pixel and trace it
+    return trace(rays.at(x, y), 0);
+}
 
-        // Launch threads
-        std::vector<std::thread> threads;
-        for (int t = 0; t < num_threads; ++t) {
-            int start = t * chunk_size;
-            int end = std::min(start + chunk_size, static_cast<int>(camera.v_res));
-            threads.emplace_back(renderChunk, this, std::ref(camera), start, end, std::ref(buffer), std::ref(buffer_mutex), std::ref(completed_scanlines), total_scanlines, std::ref(cerr_mutex));
+void SceneBuilder::exportScene() {
+    renderScene(true);
+}
+
+RenderSummary SceneBuilder::renderScene(bool write_images) {
+    if (wavefrontRendering()) {
+        return WavefrontRenderer(*this).renderScene(write_images);
+    }
+
+    if (options.replicate_geometry && replicas.empty()) {
+        replicateGeometry();
+    }
+
+    // One job per camera, all tiles of all cameras go into the same pool queue
+    std::vector<std::unique_ptr<RenderJob>> jobs;
+    long long total_pixels = 0;
+    for (const auto& camera : scene.cameras) {
+        jobs.push_back(std::make_unique<RenderJob>(camera, options.tile_order));
+        total_pixels += camera.region().pixelCount();
+        if (options.adaptive_threshold > 0 || edgeAntiAliasing()) {
+            jobs.back()->sample_counts.resize(static_cast<size_t>(camera.h_res) * camera.v_res);
+        }
+    }
+
+    Progress progress(total_pixels, options.quiet);
+    const int max_spp = options.adaptive_threshold > 0 ? options.max_spp : anti_aliasing;
+
+    TaskGroup tasks;
+    for (auto& job : jobs) {
+        for (const auto& tile : job->tiles) {
+            tasks.run([&, job = job.get()]() {
+                renderTile(this, job->camera, tile, job->buffer, progress, job->sample_counts.empty() ? nullptr : job->sample_counts.data());
+
+                // Last tile of this camera, write the image right away
+                if (--job->remaining_tiles == 0) {
+                    if (write_images) {
+                        writeImage(job->camera, job->buffer);
+                        if (!job->sample_counts.empty()) {
+                            writeSampleMap(job->camera, job->sample_counts, max_spp);
+                        }
+                    }
+                    job->buffer.release();
+                }
+            });
         }
+    }
+
+    tasks.wait();
+    progress.finish();
 
-        // Wait for all threads to finish
-        for (auto& thread : threads) {
-            thread.join();
+    if ((options.adaptive_threshold > 0 || edgeAntiAliasing()) && !options.quiet && total_pixels > 0) {
+        double average = static_cast<double>(progress.samples()) / total_pixels;
+        cout << (edgeAntiAliasing() ? "Edge anti aliasing: " : "Adaptive sampling: ") << std::fixed << std::setprecision(2) << average << " spp on average, "
+             << static_cast<double>(max_spp) / average << "x fewer samples than " << max_spp << " spp everywhere\n"
+             << std::defaultfloat;
+    }
+
+    return RenderSummary{progress.elapsedSeconds(), progress.stats()};
+}
+
+void SceneBuilder::renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress) {
+    // Only the pages of the requested tiles are ever touched
+    Framebuffer buffer(camera.h_res, camera.v_res);
+
+    TaskGroup tasks;
+    for (const auto& tile : tiles) {
+        tasks.run([&]() {
+            renderTile(this, camera, tile, buffer, progress, nullptr);
+        });
+    }
+    tasks.wait();
+
+    pixels.clear();
+    for (const auto& tile : tiles) {
+        for (int j = tile.y0; j < tile.y1; ++j) {
+            for (int i = tile.x0; i < tile.x1; ++i) {
+                pixels.push_back(buffer.get(i, j));
+            }
         }
+    }
+}
+
+void SceneBuilder::renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress, GBuffer& gbuffer) {
+    // The samples per pixel are not known up front, there is nothing fixed to keep
+    if (options.adaptive_threshold > 0 || edgeAntiAliasing()) {
+        gbuffer.clear();
+        renderTiles(camera, tiles, pixels, progress);
+        return;
+    }
+
+    const int count = anti_aliasing;
+    const bool cached = gbuffer.matches(camera, tiles, count);
+    if (!cached) {
+        gbuffer.reset(camera, tiles, count);
+    }
+
+    std::vector<size_t> first_pixel;
+    size_t total = 0;
+    for (const auto& tile : tiles) {
+        first_pixel.push_back(total);
+        total += tile.pixelCount();
+    }
+    pixels.resize(total);
+
+    RayGenerator rays(camera);
+    const Sampler& sampler = getSampler(options.sampler);
+    TaskGroup tasks;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        tasks.run([&, t]() {
+            RenderStats& stats = localStats();
+            RenderStats before = stats;
+            const Tile& tile = tiles[t];
+            GBufferSample* samples = gbuffer.tileSamples(t);
+
+            if (!cached) {
+                GBufferSample* sample = samples;
+                for (int j = tile.y0; j < tile.y1; ++j) {
+                    for (int i = tile.x0; i < tile.x1; ++i) {
+                        for (int k = 0; k < count; ++k, ++sample) {
+                            double u, v;
+                            sampler.sample(i, j, k, count, u, v);
+                            sample->ray = rays.at(i + u, j + v);
+                            if (options.count_rays) {
+                                stats.primary_rays++;
+                            }
+
+                            Hit hit;
+                            if (!intersect(sample->ray, hit)) {
+                                sample->object = -1;
+                                continue;
+                            }
+                            auto material = std::find_if(scene.materials.begin(), scene.materials.end(), [&](const Material& m) { return m.id == hit.material.id; });
+                            sample->t = hit.t;
+                            sample->position = hit.hit_point;
+                            sample->normal = hit.normal;
+                            sample->object = hit.object;
+                            sample->material = static_cast<int>(material - scene.materials.begin());
+                        }
+                    }
+                }
+            }
 
-        // Write the buffer to the output file
-        for (const auto& color : buffer) {
-            out << color;
+            // Averaged like samplePixel, so cached and uncached renders agree
+            Radiance* out = &pixels[first_pixel[t]];
+            for (int p = 0; p < tile.pixelCount(); ++p) {
+                Color color(0, 0, 0);
+                for (int k = 0; k < count; ++k) {
+                    color += shadeSample(samples[static_cast<size_t>(p) * count + k]).color();
+                }
+                out[p] = Radiance(color / count);
+            }
+            if (options.count_rays) {
+                stats.samples += static_cast<long long>(tile.pixelCount()) * count;
+            }
+            progress.add(tile.pixelCount(), stats - before);
+        });
+    }
+    // Rethrows if a tile failed, the half filled buffer stays invalid
+    tasks.wait();
+    if (!cached) {
+        gbuffer.markFilled();
+    }
+}
+
+Radiance SceneBuilder::shadeSample(const GBufferSample& sample) {
+    if (sample.object < 0) {
+        return background();
+    }
+    Hit hit;
+    hit.t = sample.t;
+    hit.hit_point = sample.position;
+    hit.normal = sample.normal;
+    hit.material = scene.materials[sample.material];
+    hit.object = sample.object;
+    return shadeHit(sample.ray, hit, 0, Color(1, 1, 1), nullptr);
+}
+
+void SceneBuilder::updateLight(const PointLight& light) {
+    for (auto& l : scene.lights) {
+        if (l.id == light.id) {
+            l = light;
+            buildLightBVH();
+            return;
         }
+    }
+    throw std::runtime_error("No PointLight with id " + std::to_string(light.id));
+}
+
+void SceneBuilder::updateMaterial(const Material& material) {
+    auto it = std::find_if(scene.materials.begin(), scene.materials.end(), [&](const Material& m) { return m.id == material.id; });
+    if (it == scene.materials.end()) {
+        throw std::runtime_error("No Material with id " + std::to_string(material.id));
+    }
+    *it = material;
 
-        out.close();
-        std::cerr << std::endl;
+    // Objects keep their own copy of the material
+    for (auto obj : scene.objects) {
+        if (obj->material.id == material.id) {
+            obj->material = material;
+        }
+    }
+    for (auto& replica : replicas) {
+        for (auto obj : replica.objects) {
+            if (obj->material.id == material.id) {
+                obj->material = material;
+            }
+        }
     }
 }
 
@@ -236,95 +682,510 @@ void SceneBuilder::printScene() {
 // Private methods //
 /////////////////////
 
-RGB SceneBuilder::trace(const Ray &ray, int depth)
-{
-    Hit hit;
-    bool hit_found = false;
-    // Loop all objects in the scene
-    for(auto obj : scene.objects) {
-        Hit obj_hit = obj->intersect(ray);
-        // If hit found
-        if(obj_hit.is_hit() && (!hit_found || obj_hit.t < hit.t)) {
-            // Closest hit
+void SceneBuilder::buildObjectBVH() {
+    std::vector<AABB> boxes;
+    boxes.reserve(scene.objects.size());
+    for (auto obj : scene.objects) {
+        boxes.push_back(obj->bounds());
+    }
+    object_bvh.build(boxes);
+}
+
+void SceneBuilder::buildLightBVH() {
+    light_bvh.clear();
+    light_radius_sq.clear();
+    light_node_power.clear();
+    if (options.light_cutoff <= 0 && options.light_samples <= 0) {
+        return;
+    }
+
+    // intensity / d^2 drops below the cutoff at d = sqrt(intensity / cutoff).
+    // Without a cutoff the boxes are just the light positions, for sampling.
+    std::vector<AABB> boxes;
+    boxes.reserve(scene.lights.size());
+    for (const auto& light : scene.lights) {
+        double radius = options.light_cutoff > 0 ? std::sqrt(lightPower(light) / options.light_cutoff) : 0;
+        Vector extent(radius, radius, radius);
+        boxes.push_back(AABB(light.position - extent, light.position + extent));
+        if (options.light_cutoff > 0) {
+            light_radius_sq.push_back(radius * radius);
+        }
+    }
+    light_bvh.build(boxes);
+
+    // Children always come after their parent, so a reverse sweep sums leaves first
+    const std::vector<BVH::Node>& nodes = light_bvh.getNodes();
+    const std::vector<int>& indices = light_bvh.getIndices();
+    light_node_power.assign(nodes.size(), 0);
+    for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; --n) {
+        if (nodes[n].count > 0) {
+            for (int i = nodes[n].first; i < nodes[n].first + nodes[n].count; ++i) {
+                light_node_power[n] += lightPower(scene.lights[indices[i]]);
+            }
+        }
+        else {
+            light_node_power[n] = light_node_power[nodes[n].first] + light_node_power[nodes[n].first + 1];
+        }
+    }
+}
+
+bool SceneBuilder::samplingLights() const {
+    return options.light_samples > 0 && scene.lights.size() > static_cast<size_t>(options.light_samples) && !light_node_power.empty();
+}
+
+bool SceneBuilder::edgeAntiAliasing() const {
+    return options.edge_aa && (anti_aliasing > 1 || options.adaptive_threshold > 0);
+}
+
+bool SceneBuilder::wavefrontRendering() const {
+    // Adaptive and edge anti aliasing decide per pixel, they stay on the recursive path
+    return options.wavefront && options.adaptive_threshold <= 0 && !edgeAntiAliasing();
+}
+
+int SceneBuilder::sampleLight(const Point& p, double& pdf) const {
+    const std::vector<BVH::Node>& nodes = light_bvh.getNodes();
+    const std::vector<int>& indices = light_bvh.getIndices();
+
+    // Power over squared distance, the distance is clamped to the node size so
+    // a node around p is not treated as infinitely bright
+    auto node_importance = [&](int n) {
+        const AABB& box = nodes[n].bounds;
+        if (!light_radius_sq.empty() && !box.contains(p)) {
+            return 0.0;
+        }
+        Point center = box.centroid();
+        double half_diagonal_sq = (box.max - box.min).length_sqr() * 0.25;
+        return light_node_power[n] / std::max((center - p).length_sqr(), std::max(half_diagonal_sq, 1e-6));
+    };
+
+    pdf = 1;
+    int n = 0;
+    while (nodes[n].count == 0) {
+        double left = node_importance(nodes[n].first);
+        double right = node_importance(nodes[n].first + 1);
+        if (left + right <= 0) {
+            return -1;
+        }
+        double p_left = left / (left + right);
+        if (generate_random_double() < p_left) {
+            pdf *= p_left;
+            n = nodes[n].first;
+        }
+        else {
+            pdf *= 1 - p_left;
+            n = nodes[n].first + 1;
+        }
+    }
+
+    // Lights of the leaf by their exact importance
+    auto light_importance = [&](int l) {
+        return lightReaches(l, p) ? lightPower(scene.lights[l]) / std::max((scene.lights[l].position - p).length_sqr(), 1e-6) : 0.0;
+    };
+    const int first = nodes[n].first, last = nodes[n].first + nodes[n].count;
+    double total = 0;
+    for (int i = first; i < last; ++i) {
+        total += light_importance(indices[i]);
+    }
+    if (total <= 0) {
+        return -1;
+    }
+    double u = generate_random_double() * total;
+    for (int i = first; i < last; ++i) {
+        double weight = light_importance(indices[i]);
+        if (u < weight || i == last - 1) {
+            pdf *= weight / total;
+            return weight > 0 ? indices[i] : -1;
+        }
+        u -= weight;
+    }
+    return -1;
+}
+
+bool SceneBuilder::lightReaches(int light, const Point& p) const {
+    return light_radius_sq.empty() || (scene.lights[light].position - p).length_sqr() < light_radius_sq[light];
+}
+
+void SceneBuilder::replicateGeometry() {
+    const CpuTopology& topology = CpuTopology::get();
+    if (topology.nodeCount() < 2) {
+        return;
+    }
+
+    // Objects are cloned by a thread bound to the target node so first touch places them there
+    replicas.resize(topology.nodeCount());
+    for (int node = 0; node < topology.nodeCount(); ++node) {
+        std::thread copier([this, node, &topology]() {
+            pinCurrentThread(topology.nodeCpus(node));
+            for (auto obj : scene.objects) {
+                replicas[node].objects.push_back(obj->clone());
+            }
+            replicas[node].bvh = object_bvh;
+        });
+        copier.join();
+    }
+}
+
+void SceneBuilder::releaseReplicas() {
+    for (auto& replica : replicas) {
+        for (auto obj : replica.objects) {
+            delete obj;
+        }
+    }
+    replicas.clear();
+}
+
+const std::vector<Object*>& SceneBuilder::localObjects() const {
+    int node = ThreadPool::currentNode();
+    if (node >= 0 && node < static_cast<int>(replicas.size())) {
+        return replicas[node].objects;
+    }
+    return scene.objects;
+}
+
+const BVH& SceneBuilder::localBVH() const {
+    int node = ThreadPool::currentNode();
+    if (node >= 0 && node < static_cast<int>(replicas.size())) {
+        return replicas[node].bvh;
+    }
+    return object_bvh;
+}
+
+bool SceneBuilder::intersect(const Ray& ray, Hit& hit) const {
+    const std::vector<Object*>& objects = localObjects();
+    const BVH& bvh = localBVH();
+
+    hit.t = INF;
+    auto test_object = [&](int index) {
+        Hit obj_hit = objects[index]->intersect(ray);
+        // Closest hit
+        if (obj_hit.is_hit() && obj_hit.t < hit.t) {
             hit = obj_hit;
-            hit_found = true;
+            hit.object = index;
+        }
+        return false;
+    };
+
+    // Scenes handed in without parsing have no BVH
+    if (bvh.empty()) {
+        for (size_t i = 0; i < objects.size(); ++i) {
+            test_object(i);
+        }
+    }
+    else {
+        bvh.traverse(ray, hit.t, test_object);
+    }
+    return hit.is_hit();
+}
+
+// Object that blocked the last shadow ray of this thread towards each light, -1 if none yet.
+// A stale entry only costs one wasted test, the object is always re-tested.
+static std::vector<int>& lastOccluders() {
+    thread_local std::vector<int> last_occluder;
+    return last_occluder;
+}
+
+bool SceneBuilder::occluded(const Ray& ray, double max_distance, int light) const {
+    const std::vector<Object*>& objects = localObjects();
+    const BVH& bvh = localBVH();
+
+    // Neighbouring hits are usually blocked by the same object, try it before any traversal
+    int* cached = nullptr;
+    if (light >= 0 && options.shadow_cache) {
+        std::vector<int>& last_occluder = lastOccluders();
+        if (static_cast<size_t>(light) >= last_occluder.size()) {
+            last_occluder.resize(scene.lights.size(), -1);
+        }
+        cached = &last_occluder[light];
+
+        RenderStats& stats = localStats();
+        if (options.count_rays) {
+            stats.shadow_cache_lookups++;
+        }
+        if (*cached >= 0 && *cached < static_cast<int>(objects.size())) {
+            Hit shadow_hit = objects[*cached]->intersect(ray);
+            if (shadow_hit.is_hit() && shadow_hit.t < max_distance) {
+                if (options.count_rays) {
+                    stats.shadow_cache_hits++;
+                }
+                return true;
+            }
         }
     }
 
-    if(hit_found) {
-        RGB total_color(0, 0, 0);
-        for(auto& light : scene.lights) {
-            RGB light_color = shade(ray, hit, light, depth);
-            total_color = total_color + light_color;
+    bool blocked = false;
+    auto test_object = [&](int index) {
+        Hit shadow_hit = objects[index]->intersect(ray);
+        blocked = shadow_hit.is_hit() && shadow_hit.t < max_distance;
+        if (blocked && cached) {
+            *cached = index;
+        }
+        return blocked;
+    };
+
+    if (bvh.empty()) {
+        for (size_t i = 0; i < objects.size() && !blocked; ++i) {
+            test_object(i);
         }
-        return total_color;
     }
     else {
-        return scene.background_color;
+        bvh.traverse(ray, max_distance, test_object);
     }
+    return blocked;
 }
 
-RGB SceneBuilder::shade(const Ray& ray, const Hit &hit, const PointLight &light, int depth) {
-    if(depth > scene.max_raytracedepth) {
-        return RGB(0, 0, 0);
+void SceneBuilder::intersectPacket(RayPacket& packet, Hit* hits) const {
+    const std::vector<Object*>& objects = localObjects();
+    const BVH& bvh = localBVH();
+
+    // Divergent packets gain nothing from sharing a traversal
+    if (bvh.empty() || !packet.coherent) {
+        for (int r = 0; r < packet.size; ++r) {
+            intersect(packet.rays[r], hits[r]);
+        }
+        return;
     }
-    
-    Color curr_light(hit.material.ambient.e[0] * scene.ambient_light.r,
-                    hit.material.ambient.e[1] * scene.ambient_light.g,
-                    hit.material.ambient.e[2] * scene.ambient_light.b);
 
-    Vector light_direction = light.position - hit.hit_point;
-    light_direction = light_direction.normalize();
-    double distance_to_light = light_direction.length();
+    for (int r = 0; r < packet.size; ++r) {
+        hits[r].t = INF;
+    }
+    bvh.traversePacket(packet, packet.active, [&](int index, uint32_t mask) {
+        // t_max follows the closest hit, a ray whose t_max shrank hit this object
+        double before[MAX_PACKET_SIZE];
+        for (uint32_t m = mask, r = 0; m; ++r, m >>= 1) {
+            before[r] = packet.t_max[r];
+        }
+        objects[index]->intersectPacket(packet, mask, hits);
+        for (uint32_t m = mask, r = 0; m; ++r, m >>= 1) {
+            if ((m & 1) && packet.t_max[r] != before[r]) {
+                hits[r].object = index;
+            }
+        }
+    });
+}
 
-    // Shadow check
-    Ray shadow_ray(hit.hit_point, light_direction);
-    bool in_shadow = false;
-    for(auto obj : scene.objects) {
-        Hit shadow_hit = obj->intersect(shadow_ray);
-        if(shadow_hit.is_hit() && shadow_hit.t < distance_to_light) {
-            in_shadow = true;
-            break;
+uint32_t SceneBuilder::occludedPacket(RayPacket& packet) const {
+    const std::vector<Object*>& objects = localObjects();
+    const BVH& bvh = localBVH();
+
+    uint32_t blocked = 0;
+    if (bvh.empty() || !packet.coherent) {
+        for (int r = 0; r < packet.size; ++r) {
+            if ((packet.active >> r) & 1 && occluded(packet.rays[r], packet.t_max[r])) {
+                blocked |= 1u << r;
+            }
         }
+        return blocked;
     }
 
-    if(!in_shadow) {
-        // Diffuse reflectance
-        double diffuse_factor = std::max(0.0, light_direction.dot(hit.normal));
-        double cosine = diffuse_factor / (hit.normal.length() * light_direction.length());
-        curr_light += (light.intensity / (distance_to_light * distance_to_light)) * cosine * hit.material.diffuse;
-        
-        // Specular reflectance
-        Vector reflection = (light_direction * -1.0) - hit.normal * (light_direction.dot(hit.normal)) * 2;
-        Vector view_direction = ray.direction() * -1.0;
-        double specular_factor = std::pow(std::max(0.0, reflection.dot(view_direction)), hit.material.phong_exponent);
+    uint32_t initial = packet.active;
+    bvh.traversePacket(packet, packet.active, [&](int index, uint32_t mask) {
+        objects[index]->occludePacket(packet, mask);
+    });
+    return initial & ~packet.active;
+}
 
-        curr_light += (light.intensity / (distance_to_light * distance_to_light)) * specular_factor * hit.material.specular;
+void SceneBuilder::tracePacket(RayPacket& packet, Radiance* colors) {
+    RenderStats& stats = localStats();
+    if (options.count_rays) {
+        stats.primary_rays += packet.size;
+    }
 
-        // Mirror reflectance
-        if(depth < scene.max_raytracedepth && (hit.material.mirror_reflectance.x() > 0 || hit.material.mirror_reflectance.y() > 0 || hit.material.mirror_reflectance.z() > 0)) {
-            Vector reflect_dir = ray.direction() - hit.normal * 2.0 * ray.direction().dot(hit.normal);
-            reflect_dir = reflect_dir.normalize();
-            Ray reflect_ray(hit.hit_point + reflect_dir * 1e-4, reflect_dir);
-            RGB reflect_color = trace(reflect_ray, depth + 1);
+    Hit hits[MAX_PACKET_SIZE];
+    intersectPacket(packet, hits);
+
+    // Shadow rays of one light start at the light and end just above each hit point,
+    // so the packet shares an origin and the frustum test applies
+    const size_t num_lights = scene.lights.size();
+    unsigned char visible[MAX_PACKET_SIZE * MAX_PACKET_LIGHTS];
+    const bool packet_shadows = num_lights <= MAX_PACKET_LIGHTS && !samplingLights();
+    for (size_t l = 0; packet_shadows && l < num_lights; ++l) {
+        const PointLight& light = scene.lights[l];
+        RayPacket shadows;
+        int ray_of[MAX_PACKET_SIZE];
+        for (int r = 0; r < packet.size; ++r) {
+            visible[r * num_lights + l] = 0;
+            if (!hits[r].is_hit() || !lightReaches(l, hits[r].hit_point)) {
+                continue;
+            }
+            Vector light_direction = (light.position - hits[r].hit_point).normalize();
+            Vector to_point = hits[r].hit_point + light_direction * 1e-4 - light.position;
+            double distance = to_point.length();
+            ray_of[shadows.size] = r;
+            shadows.add(Ray(light.position, to_point / distance), distance);
+        }
+        shadows.finish(options.packet_frustum);
+        if (options.count_rays) {
+            stats.shadow_rays += shadows.size;
+        }
 
-            curr_light += Color(reflect_color.r / 255.0, reflect_color.g / 255.0, reflect_color.b / 255.0) * hit.material.mirror_reflectance;
+        uint32_t blocked = occludedPacket(shadows);
+        for (int s = 0; s < shadows.size; ++s) {
+            visible[ray_of[s] * num_lights + l] = !((blocked >> s) & 1);
         }
-        
     }
-    
-    for(int i = 0; i < 3; ++i) {
-        if(curr_light.e[i] > 255) {
-            curr_light.e[i] = 255;
+
+    for (int r = 0; r < packet.size; ++r) {
+        if (!hits[r].is_hit()) {
+            colors[r] = background();
         }
-        else if(curr_light.e[i] < 0) {
-            curr_light.e[i] = 0;
+        else {
+            colors[r] = shadeHit(packet.rays[r], hits[r], 0, Color(1, 1, 1), packet_shadows ? &visible[r * num_lights] : nullptr);
         }
     }
+}
 
-    return RGB(static_cast<short>(curr_light.e[0]), 
-                static_cast<short>(curr_light.e[1]), 
-                static_cast<short>(curr_light.e[2]));
+Radiance SceneBuilder::trace(const Ray &ray, int depth, const Color& throughput)
+{
+    if(options.count_rays) {
+        RenderStats& stats = localStats();
+        if(depth == 0) {
+            stats.primary_rays++;
+        }
+        else {
+            stats.reflection_rays++;
+        }
+    }
+
+    Hit hit;
+    if(!intersect(ray, hit)) {
+        return background();
+    }
+    return shadeHit(ray, hit, depth, throughput, nullptr);
+}
+
+Radiance SceneBuilder::shadeHit(const Ray& ray, const Hit& hit, int depth, const Color& throughput, const unsigned char* light_visible) {
+    // Ambient once per hit
+    Color color = hit.material.ambient.multiply(Color(scene.ambient_light.r, scene.ambient_light.g, scene.ambient_light.b));
+
+    // Direct lighting, one shadow ray per light unless a packet already traced them
+    if(light_visible) {
+        for(size_t l = 0; l < scene.lights.size(); ++l) {
+            if(light_visible[l]) {
+                color += shade(ray, hit, scene.lights[l]);
+            }
+        }
+    }
+    else if(samplingLights()) {
+        // K lights picked by importance, each weighted by its inverse probability
+        const int samples = options.light_samples;
+        for(int k = 0; k < samples; ++k) {
+            double pdf;
+            int l = sampleLight(hit.hit_point, pdf);
+            if(l >= 0 && pdf > 0 && lightVisible(hit, l)) {
+                color += shade(ray, hit, scene.lights[l]) / (samples * pdf);
+            }
+        }
+    }
+    else if(options.light_cutoff <= 0) {
+        for(size_t l = 0; l < scene.lights.size(); ++l) {
+            if(lightVisible(hit, l)) {
+                color += shade(ray, hit, scene.lights[l]);
+            }
+        }
+    }
+    else {
+        // Only lights whose influence radius covers the hit point
+        light_bvh.query(hit.hit_point, [&](int l) {
+            if(lightReaches(l, hit.hit_point) && lightVisible(hit, l)) {
+                color += shade(ray, hit, scene.lights[l]);
+            }
+            return false;
+        });
+    }
+
+    // A single mirror ray per hit, whatever the number of lights
+    const Color& mirror = hit.material.mirror_reflectance;
+    if(depth < static_cast<int>(scene.max_raytracedepth) && (mirror.x() > 0 || mirror.y() > 0 || mirror.z() > 0)) {
+        // The reflected light reaches the pixel scaled by the path throughput. Stop once that
+        // can no longer show, or let roulette keep an unbiased fraction of those paths with
+        // their weight scaled up to match.
+        Color next_throughput = throughput.multiply(mirror);
+        double contribution = std::max(next_throughput.x(), std::max(next_throughput.y(), next_throughput.z()));
+        double weight = 1;
+        if(contribution < options.reflection_cutoff) {
+            double survive = contribution / options.reflection_cutoff;
+            if(!options.russian_roulette || generate_random_double() >= survive) {
+                return Radiance(color);
+            }
+            weight = 1 / survive;
+            next_throughput = next_throughput * weight;
+        }
+
+        Vector reflect_dir = ray.direction() - hit.normal * 2.0 * ray.direction().dot(hit.normal);
+        reflect_dir = reflect_dir.normalize();
+        Ray reflect_ray(hit.hit_point + reflect_dir * 1e-4, reflect_dir);
+        Radiance reflect_color = trace(reflect_ray, depth + 1, next_throughput);
+
+        color += mirror.multiply(reflect_color.color()) * weight;
+    }
+
+    // Left unclamped, the image is clamped once when it is quantized
+    return Radiance(color);
+}
+
+void SceneBuilder::shadingLights(const Point& p, std::vector<std::pair<int, double>>& lights) const {
+    lights.clear();
+    if(samplingLights()) {
+        const int samples = options.light_samples;
+        for(int k = 0; k < samples; ++k) {
+            double pdf;
+            int l = sampleLight(p, pdf);
+            if(l >= 0 && pdf > 0) {
+                lights.emplace_back(l, 1 / (samples * pdf));
+            }
+        }
+    }
+    else if(options.light_cutoff <= 0) {
+        for(size_t l = 0; l < scene.lights.size(); ++l) {
+            lights.emplace_back(l, 1.0);
+        }
+    }
+    else {
+        light_bvh.query(p, [&](int l) {
+            if(lightReaches(l, p)) {
+                lights.emplace_back(l, 1.0);
+            }
+            return false;
+        });
+    }
+}
+
+Radiance SceneBuilder::background() const {
+    return Radiance(scene.background_color.r, scene.background_color.g, scene.background_color.b);
+}
+
+bool SceneBuilder::lightVisible(const Hit& hit, int light_index) const {
+    const PointLight& light = scene.lights[light_index];
+    Vector light_direction = light.position - hit.hit_point;
+    double distance_to_light = light_direction.length();
+    light_direction = light_direction.normalize();
+
+    // Offset so the ray does not hit the surface it starts on
+    Ray shadow_ray(hit.hit_point + light_direction * 1e-4, light_direction);
+    if(options.count_rays) {
+        localStats().shadow_rays++;
+    }
+    return !occluded(shadow_ray, distance_to_light, light_index);
+}
+
+Color SceneBuilder::shade(const Ray& ray, const Hit &hit, const PointLight &light) const {
+    Vector light_direction = light.position - hit.hit_point;
+    double distance_to_light = light_direction.length();
+    light_direction = light_direction.normalize();
+
+    Color irradiance = light.intensity / (distance_to_light * distance_to_light);
+
+    // Diffuse reflectance
+    double cosine = std::max(0.0, light_direction.dot(hit.normal));
+    Color curr_light = irradiance.multiply(hit.material.diffuse) * cosine;
+
+    // Specular reflectance
+    Vector reflection = hit.normal * (light_direction.dot(hit.normal)) * 2 - light_direction;
+    Vector view_direction = ray.direction() * -1.0;
+    double specular_factor = std::pow(std::max(0.0, reflection.dot(view_direction)), hit.material.phong_exponent);
+    curr_light += irradiance.multiply(hit.material.specular) * specular_factor;
+
+    return curr_light;
 }
 
 
@@ -418,6 +1279,27 @@ void SceneBuilder::parseCamera(tinyxml2::XMLElement* camera_element) {
     tinyxml2::XMLElement* iname_element = camera_element->FirstChildElement("ImageName");
     curr_camera.image_name = iname_element->GetText();
 
+    //Crop, optional, the command line overrides it
+    tinyxml2::XMLElement* crop_element = camera_element->FirstChildElement("Crop");
+    if (crop_element) {
+        iss.clear();
+        iss.str(crop_element->GetText());
+        iss >> curr_camera.crop.x0 >> curr_camera.crop.y0 >> curr_camera.crop.x1 >> curr_camera.crop.y1;
+        curr_camera.crop_fill = crop_element->BoolAttribute("fill");
+    }
+    if (options.crop.width() > 0 && options.crop.height() > 0) {
+        curr_camera.crop = options.crop;
+    }
+    if (options.crop_fill) {
+        curr_camera.crop_fill = true;
+    }
+    if (curr_camera.crop.width() > 0 && curr_camera.crop.height() > 0) {
+        Tile region = curr_camera.region();
+        if (region.width() <= 0 || region.height() <= 0) {
+            throw std::runtime_error("Crop window of camera " + std::to_string(curr_camera.id) + " is outside the image");
+        }
+    }
+
     scene.cameras.push_back(curr_camera);
 }
 
@@ -524,21 +1406,49 @@ void SceneBuilder::parseVertexData(tinyxml2::XMLElement* root) {
 void SceneBuilder::parseObjects(tinyxml2::XMLElement* root) {
     tinyxml2::XMLElement* objects_element = root->FirstChildElement("Objects");
 
+    std::vector<tinyxml2::XMLElement*> object_elements;
     for (tinyxml2::XMLElement* object_element = objects_element->FirstChildElement(); object_element; object_element = object_element->NextSiblingElement()) {
-        std::string object_type = object_element->Name();
-        if(object_type == "Mesh") {
-            parseMesh(object_element);
-        }
-        else if(object_type == "Triangle") {
-            parseTriangle(object_element);
-        }
-        else if(object_type == "Sphere") {
-            parseSphere(object_element);
-        }
+        object_elements.push_back(object_element);
+    }
+
+    // Every object is parsed as its own task, each one fills its own slot so order is kept
+    size_t first = scene.objects.size();
+    scene.objects.resize(first + object_elements.size(), nullptr);
+
+    TaskGroup parsers;
+    for (size_t i = 0; i < object_elements.size(); ++i) {
+        parsers.run([this, &parsers, element = object_elements[i], slot = first + i]() {
+            Object* obj = parseObject(element);
+            scene.objects[slot] = obj;
+            if (obj) {
+                // Build as a follow-up task, later objects keep parsing meanwhile
+                parsers.run([obj]() { obj->build(); });
+            }
+        });
+    }
+    parsers.wait();
+
+    // Drop unknown object types
+    scene.objects.erase(std::remove(scene.objects.begin() + first, scene.objects.end(), nullptr), scene.objects.end());
+
+    buildObjectBVH();
+}
+
+Object* SceneBuilder::parseObject(tinyxml2::XMLElement* object_element) {
+    std::string object_type = object_element->Name();
+    if(object_type == "Mesh") {
+        return parseMesh(object_element);
+    }
+    else if(object_type == "Triangle") {
+        return parseTriangle(object_element);
+    }
+    else if(object_type == "Sphere") {
+        return parseSphere(object_element);
     }
+    return nullptr;
 }
 
-void SceneBuilder::parseMesh(tinyxml2::XMLElement* mesh_element) {
+Object* SceneBuilder::parseMesh(tinyxml2::XMLElement* mesh_element) {
     Mesh *curr_mesh = new Mesh();
 
     // id
@@ -562,10 +1472,10 @@ void SceneBuilder::parseMesh(tinyxml2::XMLElement* mesh_element) {
         curr_mesh->faces.push_back(temp);
     }
 
-    scene.objects.push_back(curr_mesh);
+    return curr_mesh;
 }
 
-void SceneBuilder::parseTriangle(tinyxml2::XMLElement* triangle_element) {
+Object* SceneBuilder::parseTriangle(tinyxml2::XMLElement* triangle_element) {
     Triangle* curr_triangle = new Triangle();
 
     // id
@@ -586,10 +1496,10 @@ void SceneBuilder::parseTriangle(tinyxml2::XMLElement* triangle_element) {
     curr_triangle->coords[1] = scene.vertexdata[y - 1];
     curr_triangle->coords[2] = scene.vertexdata[z - 1];
 
-    scene.objects.push_back(curr_triangle);
+    return curr_triangle;
 }
 
-void SceneBuilder::parseSphere(tinyxml2::XMLElement* sphere_element) {
+Object* SceneBuilder::parseSphere(tinyxml2::XMLElement* sphere_element) {
     Sphere* curr_sphere = new Sphere();
 
     // id
@@ -609,5 +1519,5 @@ void SceneBuilder::parseSphere(tinyxml2::XMLElement* sphere_element) {
     tinyxml2::XMLElement* radius_element = sphere_element->FirstChildElement("Radius");
     curr_sphere->radius = radius_element->DoubleText();
 
-    scene.objects.push_back(curr_sphere);
+    return curr_sphere;
 }
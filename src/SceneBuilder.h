@@ -2,11 +2,27 @@
 #define _SCENEBUILDER_H
 
 #include <string>
+#include <vector>
 #include "shape/Object.h"
 #include "scene/Scene.h"
 #include "Hit.h"
+#include "RenderOptions.h"
+#include "Progress.h"
+#include "render/Tile.h"
+#include "render/Framebuffer.h"
+#include "render/RayGenerator.h"
+#include "render/RenderStats.h"
+#include "render/GBuffer.h"
+#include "accel/BVH.h"
+#include "accel/RayPacket.h"
 #include "../include/tinyxml2.h"
 
+// Objects and the BVH over them, kept once per NUMA node when geometry is replicated
+struct GeometryReplica {
+    std::vector<Object*> objects;
+    BVH bvh;
+};
+
 class SceneBuilder {
 public:
     SceneBuilder();
@@ -16,18 +32,98 @@ public:
 
     void importScene(char*);
     void exportScene();
+    RenderSummary renderScene(bool write_images);
+    // Renders the given tiles of a camera, pixels come back tile after tile in row-major order.
+    // The camera does not have to be one of the scene's cameras.
+    void renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress);
+    // Same, keeping the primary hits in gbuffer. When gbuffer already holds this view no camera
+    // ray is traced, only shading and secondary rays. Adaptive and edge anti aliasing bypass it.
+    void renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress, GBuffer& gbuffer);
+    // True if --wavefront is set and the anti aliasing mode can run on the wavefront renderer
+    bool wavefrontRendering() const;
+
+    // Color of one camera ray through image position (x, y), see RayGenerator::at
+    Radiance sample(const RayGenerator& rays, double x, double y);
+
+    // Scene edits, applied to every object using the material
+    void updateLight(const PointLight& light);
+    void updateMaterial(const Material& material);
     void printScene();
     void setAntiAliasing(int);
     int getAntiAliasing();
+    void setOptions(const RenderOptions&);
+    const RenderOptions& getOptions();
+    const Scene& getScene() const;
 
 private:
     Scene scene;
     int anti_aliasing;
+    RenderOptions options;
+
+    // Packets trace shadow rays for at most this many lights, more fall back to single rays
+    static const int MAX_PACKET_LIGHTS = 16;
+
+    // BVH over scene.objects, built once all objects are parsed
+    BVH object_bvh;
+
+    // BVH over the influence boxes of scene.lights and the squared influence radii
+    BVH light_bvh;
+    std::vector<double> light_radius_sq;
+    // Summed power of the lights below each light_bvh node, for light sampling
+    std::vector<double> light_node_power;
+
+    // Copies of scene.objects and object_bvh allocated on each NUMA node, indexed by node
+    std::vector<GeometryReplica> replicas;
+
+    void buildObjectBVH();
+    // Influence boxes of the lights, empty unless options.light_cutoff is set
+    void buildLightBVH();
+    // True if the light's intensity / d^2 at p is above the cutoff (always without a cutoff)
+    bool lightReaches(int light, const Point& p) const;
+    // True if hits shade options.light_samples sampled lights instead of every light
+    bool samplingLights() const;
+    // True if only pixels on edges are supersampled, see renderTileEdges
+    bool edgeAntiAliasing() const;
+    // Picks a light for p by walking the light BVH by power / d^2, returns -1 if no light
+    // reaches p. pdf receives the probability of the pick.
+    int sampleLight(const Point& p, double& pdf) const;
+    void replicateGeometry();
+    void releaseReplicas();
+    const std::vector<Object*>& localObjects() const;
+    const BVH& localBVH() const;
+
+    // Closest hit along the ray, false if nothing is hit
+    bool intersect(const Ray& ray, Hit& hit) const;
+    // True if any object blocks the ray before max_distance
+    // With a light index, the thread's last occluder for that light is tested first
+    bool occluded(const Ray& ray, double max_distance, int light = -1) const;
+
+    // Closest hits of a packet, divergent packets fall back to single rays
+    void intersectPacket(RayPacket& packet, Hit* hits) const;
+    // Bit r set for every active ray blocked before its t_max
+    uint32_t occludedPacket(RayPacket& packet) const;
+    // Colors of a packet of primary rays, shadow rays are traced as one packet per light
+    void tracePacket(RayPacket& packet, Radiance* colors);
 
-    RGB trace(const Ray& ray, int depth);
-    RGB shade(const Ray& ray, const Hit& hit, const PointLight& light, int depth);
+    // throughput is the product of the mirror reflectances along the path so far
+    Radiance trace(const Ray& ray, int depth, const Color& throughput = Color(1, 1, 1));
+    // Ambient, direct lighting and mirror reflection at a hit. light_visible holds the
+    // shadow test result per light when it is already known, otherwise shadow rays are traced.
+    Radiance shadeHit(const Ray& ray, const Hit& hit, int depth, const Color& throughput, const unsigned char* light_visible);
+    Radiance background() const;
+    // Shading of a primary hit kept in a GBuffer, with the current lights and materials
+    Radiance shadeSample(const GBufferSample& sample);
+    // Lights shadeHit shades at p and the weight of each, for renderers that queue their own shadow rays
+    void shadingLights(const Point& p, std::vector<std::pair<int, double>>& lights) const;
+    bool lightVisible(const Hit& hit, int light) const;
+    // Diffuse and specular light from one light, without the shadow test
+    Color shade(const Ray& ray, const Hit& hit, const PointLight& light) const;
 
-    friend void renderChunk(SceneBuilder* builder, const Camera& camera, int start, int end, std::vector<RGB>& buffer, std::mutex& buffer_mutex, std::atomic<int>& completed_scanlines, int total_scanlines, std::mutex& cerr_mutex);
+    // sample_counts, when given, receives the samples taken per pixel (row-major, camera.h_res wide)
+    friend class WavefrontRenderer;
+    friend void renderTilePackets(SceneBuilder* builder, const RayGenerator& rays, const Sampler& sampler, const Tile& tile, Framebuffer& buffer);
+    friend void renderTileEdges(SceneBuilder* builder, const RayGenerator& rays, const Sampler& sampler, const Tile& tile, Framebuffer& buffer, unsigned short* sample_counts);
+    friend void renderTile(SceneBuilder* builder, const Camera& camera, const Tile& tile, Framebuffer& buffer, Progress& progress, unsigned short* sample_counts);
 
     void parseScene(tinyxml2::XMLDocument& xmlDoc);
     void parseMaxRayTraceDepth(tinyxml2::XMLElement* root);
@@ -40,9 +136,10 @@ private:
     void parseMaterial(tinyxml2::XMLElement* material_element);
     void parseVertexData(tinyxml2::XMLElement* root);
     void parseObjects(tinyxml2::XMLElement* root);
-    void parseMesh(tinyxml2::XMLElement* mesh_element);
-    void parseTriangle(tinyxml2::XMLElement* triangle_element);
-    void parseSphere(tinyxml2::XMLElement* sphere_element);
+    Object* parseObject(tinyxml2::XMLElement* object_element);
+    Object* parseMesh(tinyxml2::XMLElement* mesh_element);
+    Object* parseTriangle(tinyxml2::XMLElement* triangle_element);
+    Object* parseSphere(tinyxml2::XMLElement* sphere_element);
     
 };
 
@@ -0,0 +1,153 @@
+#include <chrono>
+#include "ThreadPool.h"
+
+static thread_local int worker_node = -1;
+
+static std::unique_ptr<ThreadPool> global_pool;
+static std::mutex global_pool_mutex;
+
+ThreadPool::ThreadPool(unsigned int num_threads, AffinityPolicy affinity) : stopping(false), affinity_policy(affinity) {
+    if(num_threads == 0) {
+        num_threads = std::max(1, CpuTopology::get().cpuCount());
+    }
+    for(unsigned int i = 0; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for(auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    std::lock_guard<std::mutex> guard(global_pool_mutex);
+    if(!global_pool) {
+        global_pool = std::make_unique<ThreadPool>();
+    }
+    return *global_pool;
+}
+
+void ThreadPool::configure(unsigned int num_threads, AffinityPolicy affinity) {
+    std::lock_guard<std::mutex> guard(global_pool_mutex);
+    global_pool.reset();
+    global_pool = std::make_unique<ThreadPool>(num_threads, affinity);
+}
+
+void ThreadPool::reinitAfterFork(unsigned int num_threads, AffinityPolicy affinity) {
+    global_pool.release();
+    global_pool = std::make_unique<ThreadPool>(num_threads, affinity);
+}
+
+int ThreadPool::currentNode() {
+    return worker_node;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        tasks.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+}
+
+bool ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        if(tasks.empty()) {
+            return false;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+unsigned int ThreadPool::size() const {
+    return workers.size();
+}
+
+AffinityPolicy ThreadPool::affinity() const {
+    return affinity_policy;
+}
+
+void ThreadPool::workerLoop(int index) {
+    const CpuTopology& topology = CpuTopology::get();
+    int cpu = topology.cpuForWorker(index, affinity_policy);
+    if(cpu >= 0 && pinCurrentThread({cpu})) {
+        worker_node = topology.nodeOfCpu(cpu);
+    }
+
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if(stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference this group, never leave them dangling
+    try {
+        wait();
+    }
+    catch(...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    pending++;
+    pool.enqueue([this, task = std::move(task)]() {
+        try {
+            task();
+        }
+        catch(...) {
+            std::lock_guard<std::mutex> guard(done_mutex);
+            if(!error) {
+                error = std::current_exception();
+            }
+        }
+        std::lock_guard<std::mutex> guard(done_mutex);
+        if(--pending == 0) {
+            done_cv.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    while(pending > 0) {
+        // Help out while waiting so nested groups never starve the pool
+        if(pool.runPendingTask()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait_for(lock, std::chrono::milliseconds(1), [this] { return pending == 0; });
+    }
+
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> guard(done_mutex);
+        std::swap(e, error);
+    }
+    if(e) {
+        std::rethrow_exception(e);
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <exception>
+#include <type_traits>
+
+#include "Topology.h"
+
+// Process-wide pool of worker threads.
+// Every stage (parsing, acceleration build, rendering, encoding) submits work here
+// instead of spawning its own threads.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int num_threads = 0, AffinityPolicy affinity = AffinityPolicy::None);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    static ThreadPool& instance();
+
+    // Replaces the process-wide pool, 0 threads means one per available CPU.
+    // Must not be called while tasks are running.
+    static void configure(unsigned int num_threads, AffinityPolicy affinity);
+
+    // Creates a fresh pool in a forked child. The parent's workers do not exist
+    // there, so the old pool is abandoned instead of joined.
+    static void reinitAfterFork(unsigned int num_threads, AffinityPolicy affinity);
+
+    // NUMA node the calling worker is pinned to, -1 when it is not pinned
+    static int currentNode();
+
+    void enqueue(std::function<void()> task);
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<F>> {
+        using R = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // Runs one queued task on the calling thread, returns false if the queue is empty.
+    // Lets a thread that waits on other tasks help instead of blocking a worker.
+    bool runPendingTask();
+
+    unsigned int size() const;
+    AffinityPolicy affinity() const;
+
+private:
+    void workerLoop(int index);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping;
+    AffinityPolicy affinity_policy;
+};
+
+// A set of tasks that can be waited on together.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator =(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    // Blocks until every task has finished, rethrows the first exception thrown by a task
+    void wait();
+
+private:
+    ThreadPool& pool;
+    std::atomic<int> pending;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "Topology.h"
+
+bool parseAffinityPolicy(const std::string& name, AffinityPolicy& policy) {
+    if(name == "none") {
+        policy = AffinityPolicy::None;
+    }
+    else if(name == "compact") {
+        policy = AffinityPolicy::Compact;
+    }
+    else if(name == "scatter") {
+        policy = AffinityPolicy::Scatter;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string affinityPolicyName(AffinityPolicy policy) {
+    switch(policy) {
+        case AffinityPolicy::Compact: return "compact";
+        case AffinityPolicy::Scatter: return "scatter";
+        default: return "none";
+    }
+}
+
+// Parses lists like "0-3,8,10-11"
+static std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream iss(list);
+    std::string range;
+    while(std::getline(iss, range, ',')) {
+        if(range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for(int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Reads sizes like "2048K" from the cache entries of cpu0, 0 if there is no L2 entry
+static int readL2CacheBytes() {
+    for(int index = 0; ; ++index) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index);
+        std::ifstream level_in(dir + "/level");
+        if(!level_in) {
+            return 0;
+        }
+        int level = 0;
+        level_in >> level;
+        if(level != 2) {
+            continue;
+        }
+
+        std::ifstream size_in(dir + "/size");
+        int size = 0;
+        std::string unit;
+        size_in >> size >> unit;
+        if(unit == "K") {
+            size *= 1024;
+        }
+        else if(unit == "M") {
+            size *= 1024 * 1024;
+        }
+        return size;
+    }
+}
+
+CpuTopology::CpuTopology() : l2_bytes(0) {
+    // Only CPUs this process may run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto is_allowed = [&](int cpu) {
+        return !have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+    };
+
+    for(int node = 0; ; ++node) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if(!in) {
+            break;
+        }
+        std::string list;
+        std::getline(in, list);
+
+        std::vector<int> cpus;
+        for(int cpu : parseCpuList(list)) {
+            if(is_allowed(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if(!cpus.empty()) {
+            node_cpus.push_back(cpus);
+        }
+    }
+
+    if(node_cpus.empty()) {
+        std::vector<int> cpus;
+        int count = have_mask ? CPU_SETSIZE : static_cast<int>(std::thread::hardware_concurrency());
+        for(int cpu = 0; cpu < count; ++cpu) {
+            if(is_allowed(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        node_cpus.push_back(cpus);
+    }
+
+    l2_bytes = readL2CacheBytes();
+    if(l2_bytes <= 0) {
+        l2_bytes = 256 * 1024;
+    }
+}
+
+const CpuTopology& CpuTopology::get() {
+    static CpuTopology topology;
+    return topology;
+}
+
+int CpuTopology::nodeCount() const {
+    return node_cpus.size();
+}
+
+int CpuTopology::cpuCount() const {
+    int count = 0;
+    for(const auto& cpus : node_cpus) {
+        count += cpus.size();
+    }
+    return count;
+}
+
+const std::vector<int>& CpuTopology::nodeCpus(int node) const {
+    return node_cpus[node];
+}
+
+int CpuTopology::cpuForWorker(int worker, AffinityPolicy policy) const {
+    int cpu_count = cpuCount();
+    if(policy == AffinityPolicy::None || cpu_count == 0) {
+        return -1;
+    }
+    int slot = worker % cpu_count;
+
+    if(policy == AffinityPolicy::Compact) {
+        for(const auto& cpus : node_cpus) {
+            if(slot < static_cast<int>(cpus.size())) {
+                return cpus[slot];
+            }
+            slot -= cpus.size();
+        }
+    }
+    else {
+        // Round-robin over nodes, skipping nodes that ran out of CPUs
+        std::vector<size_t> used(node_cpus.size(), 0);
+        size_t node = 0;
+        for(int i = 0; ; ++i) {
+            while(used[node] == node_cpus[node].size()) {
+                node = (node + 1) % node_cpus.size();
+            }
+            int cpu = node_cpus[node][used[node]++];
+            if(i == slot) {
+                return cpu;
+            }
+            node = (node + 1) % node_cpus.size();
+        }
+    }
+    return -1;
+}
+
+int CpuTopology::nodeOfCpu(int cpu) const {
+    for(size_t node = 0; node < node_cpus.size(); ++node) {
+        if(std::find(node_cpus[node].begin(), node_cpus[node].end(), cpu) != node_cpus[node].end()) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+int CpuTopology::l2CacheBytes() const {
+    return l2_bytes;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
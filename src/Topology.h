@@ -0,0 +1,43 @@
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+#include <vector>
+#include <string>
+
+enum class AffinityPolicy {
+    None,       // Let the OS schedule workers
+    Compact,    // Fill the cores of one NUMA node before using the next
+    Scatter     // Spread workers round-robin over NUMA nodes
+};
+
+bool parseAffinityPolicy(const std::string& name, AffinityPolicy& policy);
+std::string affinityPolicyName(AffinityPolicy policy);
+
+// CPUs usable by this process grouped by NUMA node, read from /sys on Linux.
+// Machines without NUMA information are reported as a single node.
+class CpuTopology {
+public:
+    static const CpuTopology& get();
+
+    int nodeCount() const;
+    int cpuCount() const;
+    const std::vector<int>& nodeCpus(int node) const;
+
+    // CPU the worker with the given index should be pinned to, -1 for no pinning
+    int cpuForWorker(int worker, AffinityPolicy policy) const;
+    int nodeOfCpu(int cpu) const;
+
+    // Size of the L2 cache of the first CPU, 256 KiB when /sys does not tell
+    int l2CacheBytes() const;
+
+private:
+    CpuTopology();
+
+    std::vector<std::vector<int>> node_cpus;
+    int l2_bytes;
+};
+
+// Restricts the calling thread to the given CPUs, returns false if the OS refused
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+#endif
@@ -31,6 +31,9 @@ public:
     inline Vector operator *(const Vector&v ) const {return Vector(e[1] * v.e[2] - e[2] * v.e[1],
                                                                 e[2] * v.e[0] - e[0] * v.e[2],
                                                                 e[0] * v.e[1] - e[1] * v.e[0]);}
+    //Component-wise product, used for colors
+    inline Vector multiply(const Vector& v) const {return Vector(e[0] * v.e[0], e[1] * v.e[1], e[2] * v.e[2]);}
+
     //Dot product
     inline double dot(const Vector& v) const { return e[0] * v.e[0] + e[1] * v.e[1] + e[2] * v.e[2];}
     inline double dot(const Vector& v, Vector& v2) {return v.e[0] * v2.e[0] + v.e[1] * v2.e[1] + v.e[2] * v2.e[2];}
@@ -0,0 +1,60 @@
+#ifndef _AABB_H
+#define _AABB_H
+
+#include <algorithm>
+#include "../Vector.h"
+#include "../Hit.h"
+
+// Axis aligned bounding box
+struct AABB {
+    AABB() : min(INF, INF, INF), max(-INF, -INF, -INF) {}
+    AABB(const Point& min, const Point& max) : min(min), max(max) {}
+
+    inline void expand(const Point& p) {
+        for(int i = 0; i < 3; ++i) {
+            min.e[i] = std::min(min.e[i], p.e[i]);
+            max.e[i] = std::max(max.e[i], p.e[i]);
+        }
+    }
+
+    inline void expand(const AABB& box) {
+        expand(box.min);
+        expand(box.max);
+    }
+
+    inline Point centroid() const {return (min + max) * 0.5;}
+
+    inline int largestAxis() const {
+        Vector extent = max - min;
+        if(extent.x() >= extent.y() && extent.x() >= extent.z()) {
+            return 0;
+        }
+        return extent.y() >= extent.z() ? 1 : 2;
+    }
+
+    inline bool contains(const Point& p) const {
+        return p.x() >= min.x() && p.x() <= max.x() && p.y() >= min.y() && p.y() <= max.y() && p.z() >= min.z() && p.z() <= max.z();
+    }
+
+    // Slab test, returns the entry distance or INF if the ray misses within [0, t_max]
+    inline double intersect(const Point& origin, const Vector& inv_dir, double t_max) const {
+        double t_near = 0, t_far = t_max;
+        for(int i = 0; i < 3; ++i) {
+            double t0 = (min.e[i] - origin.e[i]) * inv_dir.e[i];
+            double t1 = (max.e[i] - origin.e[i]) * inv_dir.e[i];
+            if(t0 > t1) {
+                std::swap(t0, t1);
+            }
+            t_near = t0 > t_near ? t0 : t_near;
+            t_far = t1 < t_far ? t1 : t_far;
+            if(t_near > t_far) {
+                return INF;
+            }
+        }
+        return t_near;
+    }
+
+    Point min, max;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <numeric>
+#include "BVH.h"
+
+void BVH::build(const std::vector<AABB>& boxes) {
+    clear();
+    if(boxes.empty()) {
+        return;
+    }
+
+    indices.resize(boxes.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    std::vector<Point> centroids;
+    centroids.reserve(boxes.size());
+    for(const auto& box : boxes) {
+        centroids.push_back(box.centroid());
+    }
+
+    nodes.reserve(2 * boxes.size());
+    nodes.push_back(Node());
+    buildNode(boxes, centroids, 0, 0, boxes.size(), 0);
+}
+
+void BVH::clear() {
+    nodes.clear();
+    indices.clear();
+}
+
+AABB BVH::bounds() const {
+    return nodes.empty() ? AABB() : nodes[0].bounds;
+}
+
+// Fills nodes[node_index] with the given range of indices, splitting at the median centroid of the largest axis
+void BVH::buildNode(const std::vector<AABB>& boxes, const std::vector<Point>& centroids, int node_index, int first, int count, int depth) {
+    AABB bounds, centroid_bounds;
+    for(int i = first; i < first + count; ++i) {
+        bounds.expand(boxes[indices[i]]);
+        centroid_bounds.expand(centroids[indices[i]]);
+    }
+    nodes[node_index].bounds = bounds;
+
+    // Depth limit keeps the fixed traversal stack safe
+    if(count <= MAX_LEAF_SIZE || depth >= 60) {
+        nodes[node_index].first = first;
+        nodes[node_index].count = count;
+        nodes[node_index].axis = 0;
+        return;
+    }
+
+    int axis = centroid_bounds.largestAxis();
+    int mid = first + count / 2;
+    std::nth_element(indices.begin() + first, indices.begin() + mid, indices.begin() + first + count, [&](int a, int b) {
+        return centroids[a].e[axis] < centroids[b].e[axis];
+    });
+
+    // Children are stored next to each other
+    int left = nodes.size();
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[node_index].first = left;
+    nodes[node_index].count = 0;
+    nodes[node_index].axis = axis;
+
+    buildNode(boxes, centroids, left, first, mid - first, depth + 1);
+    buildNode(boxes, centroids, left + 1, mid, first + count - mid, depth + 1);
+}
@@ -0,0 +1,165 @@
+#ifndef _BVH_H
+#define _BVH_H
+
+#include <vector>
+#include <cstdint>
+#include "AABB.h"
+#include "RayPacket.h"
+#include "../Ray.h"
+
+// Bounding volume hierarchy over a list of boxes.
+// The BVH only knows box indices, the owner tests the actual primitives in the
+// visit callback, so the same class serves meshes (faces) and scenes (objects).
+class BVH {
+public:
+    struct Node {
+        AABB bounds;
+        int first;      // leaf: first entry in indices, inner: index of the left child (right is first + 1)
+        int count;      // 0 for inner nodes
+        int axis;       // split axis of inner nodes
+    };
+
+    void build(const std::vector<AABB>& boxes);
+    void clear();
+
+    inline bool empty() const {return nodes.empty();}
+    inline const std::vector<Node>& getNodes() const {return nodes;}
+    inline const std::vector<int>& getIndices() const {return indices;}
+    AABB bounds() const;
+
+    // Calls visit(index) for every box the ray may hit before t_max, nearest nodes first.
+    // t_max is re-read after each visit so closest-hit queries can shrink it.
+    // visit returns true to stop the traversal (any-hit queries).
+    template <typename F>
+    void traverse(const Ray& ray, const double& t_max, F&& visit) const {
+        if(nodes.empty()) {
+            return;
+        }
+        const Point origin = ray.origin();
+        const Vector dir = ray.direction();
+        const Vector inv_dir(1.0 / dir.x(), 1.0 / dir.y(), 1.0 / dir.z());
+
+        int stack[64];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while(stack_size > 0) {
+            const Node& node = nodes[stack[--stack_size]];
+            if(node.bounds.intersect(origin, inv_dir, t_max) == INF) {
+                continue;
+            }
+            if(node.count > 0) {
+                for(int i = node.first; i < node.first + node.count; ++i) {
+                    if(visit(indices[i])) {
+                        return;
+                    }
+                }
+            }
+            else {
+                // Push the far child first so the near one is visited first
+                bool left_first = dir.e[node.axis] > 0;
+                stack[stack_size++] = left_first ? node.first + 1 : node.first;
+                stack[stack_size++] = left_first ? node.first : node.first + 1;
+            }
+        }
+    }
+
+    // Calls visit(index) for every box that contains p, visit returns true to stop
+    template <typename F>
+    void query(const Point& p, F&& visit) const {
+        if(nodes.empty()) {
+            return;
+        }
+        int stack[64];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while(stack_size > 0) {
+            const Node& node = nodes[stack[--stack_size]];
+            if(!node.bounds.contains(p)) {
+                continue;
+            }
+            if(node.count > 0) {
+                for(int i = node.first; i < node.first + node.count; ++i) {
+                    if(visit(indices[i])) {
+                        return;
+                    }
+                }
+            }
+            else {
+                stack[stack_size++] = node.first + 1;
+                stack[stack_size++] = node.first;
+            }
+        }
+    }
+
+    // Traverses the rays of a coherent packet selected by mask: calls visit(index, hit_mask)
+    // for every box that at least one of them may hit, hit_mask has the bits of those rays.
+    // Nodes are ordered by the first ray that hits them, rays before it are skipped in the
+    // subtree. visit may shrink t_max or clear bits of packet.active, traversal stops once
+    // no selected ray is active. The packet's frustum, if any, culls nodes before rays are tested.
+    template <typename F>
+    void traversePacket(RayPacket& packet, uint32_t mask, F&& visit) const {
+        if(nodes.empty() || (packet.active & mask) == 0) {
+            return;
+        }
+
+        struct Entry {
+            int node;
+            int first_ray;
+        };
+        Entry stack[64];
+        int stack_size = 0;
+        stack[stack_size++] = {0, 0};
+
+        auto hits = [&](const Node& node, int r) {
+            return ((packet.active & mask) >> r & 1) && node.bounds.intersect(packet.rays[r].origin(), packet.inv_dirs[r], packet.t_max[r]) != INF;
+        };
+
+        while(stack_size > 0) {
+            Entry entry = stack[--stack_size];
+            const Node& node = nodes[entry.node];
+            if(packet.has_frustum && !packet.frustum.mayHit(node.bounds)) {
+                continue;
+            }
+
+            int first = entry.first_ray;
+            while(first < packet.size && !hits(node, first)) {
+                first++;
+            }
+            if(first == packet.size) {
+                continue;
+            }
+
+            if(node.count > 0) {
+                uint32_t hit_mask = 1u << first;
+                for(int r = first + 1; r < packet.size; ++r) {
+                    if(hits(node, r)) {
+                        hit_mask |= 1u << r;
+                    }
+                }
+                for(int i = node.first; i < node.first + node.count; ++i) {
+                    visit(indices[i], hit_mask & packet.active);
+                    if((packet.active & mask) == 0) {
+                        return;
+                    }
+                }
+            }
+            else {
+                bool left_first = packet.rays[first].direction().e[node.axis] > 0;
+                stack[stack_size++] = {left_first ? node.first + 1 : node.first, first};
+                stack[stack_size++] = {left_first ? node.first : node.first + 1, first};
+            }
+        }
+    }
+
+private:
+    static const int MAX_LEAF_SIZE = 4;
+
+    void buildNode(const std::vector<AABB>& boxes, const std::vector<Point>& centroids, int node_index, int first, int count, int depth);
+
+    std::vector<Node> nodes;
+    std::vector<int> indices;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef _RAYPACKET_H
+#define _RAYPACKET_H
+
+#include <cstdint>
+#include <cmath>
+#include "AABB.h"
+#include "../Ray.h"
+
+static const int MAX_PACKET_SIZE = 16;
+
+struct RayPacket;
+
+// Interval bounds on the inverse directions of a packet with a common origin.
+// Rejects boxes that no ray of the packet can hit with a single slab test.
+struct PacketFrustum {
+    Point origin;
+    double inv_min[3], inv_max[3];
+    double t_max = 0;
+
+    // False if the packet has no common origin or its directions do not share an octant
+    inline bool build(const RayPacket& packet);
+
+    // Conservative: false only if every ray of the packet misses the box
+    inline bool mayHit(const AABB& box) const {
+        double t_near = 0, t_far = t_max;
+        for(int axis = 0; axis < 3; ++axis) {
+            bool positive = inv_min[axis] > 0;
+            double d0 = (positive ? box.min.e[axis] : box.max.e[axis]) - origin.e[axis];
+            double d1 = (positive ? box.max.e[axis] : box.min.e[axis]) - origin.e[axis];
+            t_near = std::max(t_near, std::min(d0 * inv_min[axis], d0 * inv_max[axis]));
+            t_far = std::min(t_far, std::max(d1 * inv_min[axis], d1 * inv_max[axis]));
+            if(t_near > t_far) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Up to MAX_PACKET_SIZE rays traced together through the BVH.
+// Bit r of active is set while ray r still needs work, t_max[r] bounds its hits.
+// Call finish() once all rays are added.
+struct RayPacket {
+    int size = 0;
+    uint32_t active = 0;
+    bool common_origin = true;
+    bool coherent = true;       // All directions in one octant
+    bool has_frustum = false;
+    PacketFrustum frustum;
+    Ray rays[MAX_PACKET_SIZE];
+    Vector inv_dirs[MAX_PACKET_SIZE];
+    double t_max[MAX_PACKET_SIZE];
+
+    inline void add(const Ray& ray, double max_distance) {
+        const Vector dir = ray.direction();
+        if(size > 0) {
+            common_origin = common_origin && (ray.origin() - rays[0].origin()).length_sqr() == 0;
+            for(int axis = 0; axis < 3; ++axis) {
+                coherent = coherent && (dir.e[axis] >= 0) == (rays[0].direction().e[axis] >= 0);
+            }
+        }
+        rays[size] = ray;
+        inv_dirs[size] = Vector(1.0 / dir.x(), 1.0 / dir.y(), 1.0 / dir.z());
+        t_max[size] = max_distance;
+        active |= 1u << size;
+        size++;
+    }
+
+    inline void finish(bool use_frustum) {
+        has_frustum = use_frustum && coherent && frustum.build(*this);
+    }
+};
+
+inline bool PacketFrustum::build(const RayPacket& packet) {
+    if(!packet.common_origin || packet.size == 0) {
+        return false;
+    }
+    origin = packet.rays[0].origin();
+    for(int axis = 0; axis < 3; ++axis) {
+        inv_min[axis] = INF;
+        inv_max[axis] = -INF;
+        for(int r = 0; r < packet.size; ++r) {
+            double inv = packet.inv_dirs[r].e[axis];
+            if(!std::isfinite(inv) || (inv > 0) != (packet.inv_dirs[0].e[axis] > 0)) {
+                return false;
+            }
+            inv_min[axis] = std::min(inv_min[axis], inv);
+            inv_max[axis] = std::max(inv_max[axis], inv);
+        }
+    }
+    t_max = 0;
+    for(int r = 0; r < packet.size; ++r) {
+        t_max = std::max(t_max, packet.t_max[r]);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "RenderDaemon.h"
+#include "../Progress.h"
+#include "../render/Tile.h"
+
+using std::cout;
+
+enum ResponseStatus : int32_t {
+    RESPONSE_OK = 0,
+    RESPONSE_ERROR = 1
+};
+
+static Message textResponse(ResponseStatus status, const std::string& text) {
+    Message response(MessageType::Response);
+    response.put<int32_t>(status);
+    response.putString(text);
+    return response;
+}
+
+// "x,y,z" -> Vector
+static Vector parseVector(const std::string& value) {
+    Vector v;
+    char sep1, sep2;
+    std::istringstream iss(value);
+    if(!(iss >> v.e[0] >> sep1 >> v.e[1] >> sep2 >> v.e[2]) || sep1 != ',' || sep2 != ',') {
+        throw std::runtime_error("Expected x,y,z but got: " + value);
+    }
+    return v;
+}
+
+// Integer argument key, the whole value has to be a number
+static int parseInt(const std::string& key, const std::string& value) {
+    size_t end = 0;
+    int n = 0;
+    try {
+        n = std::stoi(value, &end);
+    }
+    catch(const std::logic_error&) {
+        // invalid_argument and out_of_range only say "stoi"
+    }
+    if(end == 0 || end != value.size()) {
+        throw std::runtime_error("invalid integer for " + key + ": " + value);
+    }
+    return n;
+}
+
+// Same for a number with a fraction
+static double parseDouble(const std::string& key, const std::string& value) {
+    size_t end = 0;
+    double d = 0;
+    try {
+        d = std::stod(value, &end);
+    }
+    catch(const std::logic_error&) {
+    }
+    if(end == 0 || end != value.size()) {
+        throw std::runtime_error("invalid number for " + key + ": " + value);
+    }
+    return d;
+}
+
+RenderDaemon::RenderDaemon(const std::string& socket_path, const RenderOptions& options) : socket_path(socket_path), options(options), listen_fd(-1), running(false) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listen_fd < 0) {
+        throw std::runtime_error("Could not create daemon socket");
+    }
+    unlink(socket_path.c_str());
+    if(bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_fd, 16) != 0) {
+        close(listen_fd);
+        throw std::runtime_error("Could not listen on " + socket_path + ": " + std::strerror(errno));
+    }
+}
+
+RenderDaemon::~RenderDaemon() {
+    if(listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+}
+
+void RenderDaemon::addScene(const std::string& name, std::unique_ptr<SceneBuilder> builder) {
+    scenes[name] = std::move(builder);
+}
+
+void RenderDaemon::run() {
+    running = true;
+    cout << "Listening on " << socket_path << "\n" << std::flush;
+
+    while(running) {
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if(client_fd < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("accept failed on " + socket_path);
+        }
+        // A client that stops sending in the middle of a request would otherwise block every other client
+        timeval timeout{CLIENT_TIMEOUT_SECONDS, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        SocketChannel channel(client_fd);
+        serveClient(channel);
+    }
+}
+
+void RenderDaemon::serveClient(Channel& channel) {
+    // Clients are served one at a time, every render already uses the whole pool
+    Message request;
+    while(running && channel.receive(request)) {
+        Message response;
+        if(request.type != MessageType::Request) {
+            response = textResponse(RESPONSE_ERROR, "Expected a request message");
+        }
+        else {
+            try {
+                response = handle(request.getString());
+            }
+            catch(const std::exception& e) {
+                response = textResponse(RESPONSE_ERROR, e.what());
+            }
+        }
+        if(!channel.send(response)) {
+            return;
+        }
+    }
+}
+
+Message RenderDaemon::handle(const std::string& command) {
+    std::istringstream iss(command);
+    std::string verb, token;
+    iss >> verb;
+
+    Arguments args;
+    while(iss >> token) {
+        size_t eq = token.find('=');
+        if(eq == std::string::npos) {
+            throw std::runtime_error("Expected key=value but got: " + token);
+        }
+        args[token.substr(0, eq)] = token.substr(eq + 1);
+    }
+
+    if(verb == "load") {
+        return load(args);
+    }
+    else if(verb == "unload") {
+        return unload(args);
+    }
+    else if(verb == "render") {
+        return render(args);
+    }
+    else if(verb == "set-light") {
+        return setLight(args);
+    }
+    else if(verb == "set-material") {
+        return setMaterial(args);
+    }
+    else if(verb == "ping") {
+        return textResponse(RESPONSE_OK, "pong");
+    }
+    else if(verb == "shutdown") {
+        running = false;
+        return textResponse(RESPONSE_OK, "bye");
+    }
+    throw std::runtime_error("Unknown command: " + verb);
+}
+
+std::string RenderDaemon::sceneName(const Arguments& args) {
+    auto name = args.find("scene");
+    return name != args.end() ? name->second : "default";
+}
+
+SceneBuilder& RenderDaemon::findScene(const Arguments& args) {
+    auto it = scenes.find(sceneName(args));
+    if(it == scenes.end()) {
+        throw std::runtime_error("Scene not loaded: " + sceneName(args));
+    }
+    return *it->second;
+}
+
+Message RenderDaemon::load(const Arguments& args) {
+    auto file = args.find("file");
+    if(file == args.end()) {
+        throw std::runtime_error("load needs file=PATH");
+    }
+    auto name = args.find("name");
+
+    auto builder = std::make_unique<SceneBuilder>();
+    builder->setAntiAliasing(1);
+    builder->setOptions(options);
+    std::string path = file->second;
+    builder->importScene(path.data());
+
+    std::string scene_name = name != args.end() ? name->second : "default";
+    scenes[scene_name] = std::move(builder);
+    gbuffers.erase(scene_name);
+    return textResponse(RESPONSE_OK, "loaded " + scene_name);
+}
+
+Message RenderDaemon::unload(const Arguments& args) {
+    auto name = args.find("name");
+    if(name == args.end() || scenes.erase(name->second) == 0) {
+        throw std::runtime_error("unload needs the name of a loaded scene");
+    }
+    gbuffers.erase(name->second);
+    return textResponse(RESPONSE_OK, "unloaded " + name->second);
+}
+
+Message RenderDaemon::render(const Arguments& args) {
+    SceneBuilder& builder = findScene(args);
+    const Scene& scene = builder.getScene();
+    if(scene.cameras.empty()) {
+        throw std::runtime_error("Scene has no cameras");
+    }
+
+    // Start from the camera with the requested id, then apply overrides
+    Camera camera = scene.cameras[0];
+    if(args.count("camera")) {
+        int id = parseInt("camera", args.at("camera"));
+        auto it = std::find_if(scene.cameras.begin(), scene.cameras.end(), [id](const Camera& c) { return c.id == id; });
+        if(it == scene.cameras.end()) {
+            throw std::runtime_error("No Camera with id " + args.at("camera"));
+        }
+        camera = *it;
+    }
+    if(args.count("position")) {
+        camera.position = parseVector(args.at("position"));
+    }
+    if(args.count("gaze")) {
+        camera.gaze = parseVector(args.at("gaze"));
+    }
+    if(args.count("up")) {
+        camera.up = parseVector(args.at("up"));
+    }
+    if(args.count("resolution")) {
+        std::istringstream iss(args.at("resolution"));
+        char sep;
+        if(!(iss >> camera.h_res >> sep >> camera.v_res) || camera.h_res == 0 || camera.v_res == 0) {
+            throw std::runtime_error("resolution needs width,height");
+        }
+    }
+
+    // The camera's crop window unless a region is asked for
+    Tile region = camera.region();
+    if(args.count("region")) {
+        std::istringstream iss(args.at("region"));
+        char sep;
+        if(!(iss >> region.x0 >> sep >> region.y0 >> sep >> region.x1 >> sep >> region.y1)) {
+            throw std::runtime_error("region needs x0,y0,x1,y1");
+        }
+        region.x0 = std::max(region.x0, 0);
+        region.y0 = std::max(region.y0, 0);
+        region.x1 = std::min(region.x1, static_cast<int>(camera.h_res));
+        region.y1 = std::min(region.y1, static_cast<int>(camera.v_res));
+        if(region.width() <= 0 || region.height() <= 0) {
+            throw std::runtime_error("region is outside the image");
+        }
+    }
+    // region() clamps the crop to the image, a resolution override can leave nothing of it
+    else if(region.width() <= 0 || region.height() <= 0) {
+        throw std::runtime_error("camera crop window is outside the " + std::to_string(camera.h_res) + "x" + std::to_string(camera.v_res) + " image");
+    }
+
+    // The override only lasts for this request, also when it throws
+    struct AntiAliasingRestore {
+        SceneBuilder& builder;
+        int previous;
+        ~AntiAliasingRestore() {builder.setAntiAliasing(previous);}
+    } restore_aa{builder, builder.getAntiAliasing()};
+    if(args.count("aa")) {
+        builder.setAntiAliasing(std::max(1, parseInt("aa", args.at("aa"))));
+    }
+
+    // Pixels of the region, row by row
+    std::vector<Radiance> tile_pixels;
+    Progress progress(region.pixelCount(), true);
+    std::vector<Tile> tiles = makeTiles(region, options.tile_order);
+    if(options.gbuffer_cache) {
+        // A different camera, region or aa refills the buffer, light and material edits reuse it
+        builder.renderTiles(camera, tiles, tile_pixels, progress, gbuffers[sceneName(args)]);
+    }
+    else {
+        builder.renderTiles(camera, tiles, tile_pixels, progress);
+    }
+
+    std::vector<Radiance> pixels(region.pixelCount());
+    size_t next = 0;
+    for(const auto& tile : tiles) {
+        for(int j = tile.y0; j < tile.y1; ++j) {
+            for(int i = tile.x0; i < tile.x1; ++i) {
+                pixels[(j - region.y0) * region.width() + (i - region.x0)] = tile_pixels[next++];
+            }
+        }
+    }
+
+    Message response(MessageType::Response);
+    response.put<int32_t>(RESPONSE_OK);
+    response.put<int32_t>(region.width());
+    response.put<int32_t>(region.height());
+    std::vector<unsigned char> quantized(3 * pixels.size());
+    quantizeImage(pixels.data(), pixels.size(), quantized.data());
+    for(unsigned char channel : quantized) {
+        response.put<uint8_t>(channel);
+    }
+    return response;
+}
+
+Message RenderDaemon::setLight(const Arguments& args) {
+    SceneBuilder& builder = findScene(args);
+    if(!args.count("id")) {
+        throw std::runtime_error("set-light needs id=N");
+    }
+    int id = parseInt("id", args.at("id"));
+
+    const auto& lights = builder.getScene().lights;
+    auto it = std::find_if(lights.begin(), lights.end(), [id](const PointLight& l) { return l.id == id; });
+    if(it == lights.end()) {
+        throw std::runtime_error("No PointLight with id " + args.at("id"));
+    }
+
+    PointLight light = *it;
+    if(args.count("position")) {
+        light.position = parseVector(args.at("position"));
+    }
+    if(args.count("intensity")) {
+        light.intensity = parseVector(args.at("intensity"));
+    }
+    builder.updateLight(light);
+    return textResponse(RESPONSE_OK, "light " + args.at("id") + " updated");
+}
+
+Message RenderDaemon::setMaterial(const Arguments& args) {
+    SceneBuilder& builder = findScene(args);
+    if(!args.count("id")) {
+        throw std::runtime_error("set-material needs id=N");
+    }
+    int id = parseInt("id", args.at("id"));
+
+    const auto& materials = builder.getScene().materials;
+    auto it = std::find_if(materials.begin(), materials.end(), [id](const Material& m) { return m.id == id; });
+    if(it == materials.end()) {
+        throw std::runtime_error("No Material with id " + args.at("id"));
+    }
+
+    Material material = *it;
+    if(args.count("ambient")) {
+        material.ambient = parseVector(args.at("ambient"));
+    }
+    if(args.count("diffuse")) {
+        material.diffuse = parseVector(args.at("diffuse"));
+    }
+    if(args.count("specular")) {
+        material.specular = parseVector(args.at("specular"));
+    }
+    if(args.count("mirror")) {
+        material.mirror_reflectance = parseVector(args.at("mirror"));
+    }
+    if(args.count("phong")) {
+        material.phong_exponent = parseDouble("phong", args.at("phong"));
+    }
+    builder.updateMaterial(material);
+    return textResponse(RESPONSE_OK, "material " + args.at("id") + " updated");
+}
@@ -0,0 +1,54 @@
+#ifndef _RENDERDAEMON_H
+#define _RENDERDAEMON_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <sstream>
+
+#include "../SceneBuilder.h"
+#include "../distributed/Channel.h"
+
+// Long-running render server on a local Unix socket.
+// Parsed scenes stay in memory between requests, so a render only pays for tracing.
+// Clients send Request messages holding one text command and get one Response back,
+// see README.md for the command set.
+class RenderDaemon {
+public:
+    RenderDaemon(const std::string& socket_path, const RenderOptions& options);
+    ~RenderDaemon();
+
+    // Takes ownership of an already parsed scene
+    void addScene(const std::string& name, std::unique_ptr<SceneBuilder> builder);
+
+    // Serves clients until a shutdown command arrives
+    void run();
+
+private:
+    typedef std::map<std::string, std::string> Arguments;
+
+    // Clients are served one at a time, one that sends nothing for this long is disconnected
+    static const int CLIENT_TIMEOUT_SECONDS = 30;
+
+    void serveClient(Channel& channel);
+    Message handle(const std::string& command);
+
+    Message load(const Arguments& args);
+    Message unload(const Arguments& args);
+    Message render(const Arguments& args);
+    Message setLight(const Arguments& args);
+    Message setMaterial(const Arguments& args);
+
+    SceneBuilder& findScene(const Arguments& args);
+    static std::string sceneName(const Arguments& args);
+
+    std::string socket_path;
+    RenderOptions options;
+    int listen_fd;
+    bool running;
+    std::map<std::string, std::unique_ptr<SceneBuilder>> scenes;
+    // Primary hits of the last render per scene, with options.gbuffer_cache
+    std::map<std::string, GBuffer> gbuffers;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "Channel.h"
+
+// Upper bound on a single message, protects against corrupt headers
+static const uint32_t MAX_PAYLOAD = 1u << 30;
+
+SocketChannel::SocketChannel(int fd) : fd(fd) {
+}
+
+SocketChannel::~SocketChannel() {
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+bool SocketChannel::send(const Message& message) {
+    uint32_t header[2] = {static_cast<uint32_t>(message.type), static_cast<uint32_t>(message.payload.size())};
+    return writeAll(reinterpret_cast<const char*>(header), sizeof(header))
+        && writeAll(message.payload.data(), message.payload.size());
+}
+
+bool SocketChannel::receive(Message& message) {
+    uint32_t header[2];
+    if(!readAll(reinterpret_cast<char*>(header), sizeof(header)) || header[1] > MAX_PAYLOAD) {
+        return false;
+    }
+    message.type = static_cast<MessageType>(header[0]);
+    message.payload.resize(header[1]);
+    message.read_pos = 0;
+    return readAll(message.payload.data(), message.payload.size());
+}
+
+int SocketChannel::pollHandle() const {
+    return fd;
+}
+
+bool SocketChannel::writeAll(const char* data, size_t size) {
+    while(size > 0) {
+        // MSG_NOSIGNAL: a dead peer must not kill us with SIGPIPE
+        ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool SocketChannel::readAll(char* data, size_t size) {
+    while(size > 0) {
+        ssize_t count = ::recv(fd, data, size, 0);
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+    }
+    return true;
+}
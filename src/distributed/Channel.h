@@ -0,0 +1,41 @@
+#ifndef _CHANNEL_H
+#define _CHANNEL_H
+
+#include "Message.h"
+
+// Two-way message stream between the coordinator and one worker.
+// The coordinator only depends on this interface, so workers on other machines
+// only need another implementation (e.g. over TCP).
+class Channel {
+public:
+    virtual ~Channel() {}
+
+    // Both return false once the other side is gone
+    virtual bool send(const Message& message) = 0;
+    virtual bool receive(Message& message) = 0;
+
+    // Descriptor that becomes readable when a message arrives, used with poll()
+    virtual int pollHandle() const = 0;
+};
+
+// Channel over a connected stream socket (Unix domain or TCP)
+class SocketChannel : public Channel {
+public:
+    explicit SocketChannel(int fd);
+    ~SocketChannel();
+
+    SocketChannel(const SocketChannel&) = delete;
+    SocketChannel& operator =(const SocketChannel&) = delete;
+
+    bool send(const Message& message) override;
+    bool receive(Message& message) override;
+    int pollHandle() const override;
+
+private:
+    bool writeAll(const char* data, size_t size);
+    bool readAll(char* data, size_t size);
+
+    int fd;
+};
+
+#endif
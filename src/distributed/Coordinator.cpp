@@ -0,0 +1,323 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "Coordinator.h"
+#include "../ThreadPool.h"
+#include "../Topology.h"
+#include "../Progress.h"
+#include "../render/Framebuffer.h"
+#include "../render/ImageWriter.h"
+#include "../render/WavefrontRenderer.h"
+
+static void putTiles(Message& message, const TileBatch& batch) {
+    message.put<int32_t>(batch.camera);
+    message.put<int32_t>(batch.tiles.size());
+    for(const auto& tile : batch.tiles) {
+        message.put(tile);
+    }
+}
+
+static TileBatch getTiles(Message& message) {
+    TileBatch batch;
+    batch.camera = message.get<int32_t>();
+    int count = message.get<int32_t>();
+    for(int i = 0; i < count; ++i) {
+        batch.tiles.push_back(message.get<Tile>());
+    }
+    return batch;
+}
+
+RenderCoordinator::RenderCoordinator(SceneBuilder& builder, int num_workers) : builder(builder), num_workers(num_workers) {
+}
+
+RenderCoordinator::~RenderCoordinator() {
+    shutdownWorkers();
+}
+
+void RenderCoordinator::spawnWorkers() {
+    const RenderOptions& options = builder.getOptions();
+    // Workers share the machine, split the CPUs between them unless told otherwise
+    unsigned int worker_threads = options.threads ? options.threads : std::max(1, CpuTopology::get().cpuCount() / num_workers);
+
+    for(int i = 0; i < num_workers; ++i) {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            throw std::runtime_error("Could not create worker socket");
+        }
+
+        pid_t pid = fork();
+        if(pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            throw std::runtime_error("Could not fork worker");
+        }
+
+        if(pid == 0) {
+            // Child: drop the coordinator's ends, the pool threads did not survive fork
+            close(fds[0]);
+            for(auto& worker : workers) {
+                worker.channel.reset();
+            }
+            ThreadPool::reinitAfterFork(worker_threads, options.affinity);
+
+            int status = 0;
+            try {
+                SocketChannel channel(fds[1]);
+                runRenderWorker(builder, channel);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "\nWorker " << getpid() << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            _exit(status);
+        }
+
+        close(fds[1]);
+        // A worker that stalls in the middle of a result must not block the coordinator
+        timeval timeout{static_cast<time_t>(MIN_BATCH_TIMEOUT.count()), 0};
+        setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        workers.push_back(WorkerProcess{pid, std::make_unique<SocketChannel>(fds[0]), std::nullopt, Clock::time_point()});
+    }
+}
+
+void RenderCoordinator::retireWorker(WorkerProcess& worker, bool graceful) {
+    worker.channel.reset();
+    if(worker.pid <= 0) {
+        return;
+    }
+
+    // Never wait on a worker without a limit, a hung one would hang the render
+    Clock::time_point deadline = Clock::now() + (graceful ? SHUTDOWN_GRACE : Clock::duration::zero());
+    while(waitpid(worker.pid, nullptr, WNOHANG) == 0) {
+        if(Clock::now() >= deadline) {
+            kill(worker.pid, SIGKILL);
+            waitpid(worker.pid, nullptr, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    worker.pid = -1;
+}
+
+void RenderCoordinator::shutdownWorkers() {
+    for(auto& worker : workers) {
+        if(worker.channel) {
+            worker.channel->send(Message(MessageType::Shutdown));
+        }
+    }
+    for(auto& worker : workers) {
+        retireWorker(worker, true);
+    }
+    workers.clear();
+}
+
+void RenderCoordinator::abandonWorker(WorkerProcess& worker, std::deque<TileBatch>& pending) {
+    if(worker.assigned) {
+        pending.push_front(*worker.assigned);
+        worker.assigned.reset();
+    }
+    retireWorker(worker, false);
+}
+
+RenderCoordinator::Clock::duration RenderCoordinator::batchTimeout() const {
+    return std::max<Clock::duration>(MIN_BATCH_TIMEOUT, slowest_batch * BATCH_TIMEOUT_FACTOR);
+}
+
+void RenderCoordinator::exportScene() {
+    const Scene& scene = builder.getScene();
+
+    spawnWorkers();
+
+    // Cut every camera into batches of tiles
+    std::deque<TileBatch> pending;
+    std::vector<std::unique_ptr<Framebuffer>> buffers;
+    std::vector<int> remaining_tiles;
+    long long total_pixels = 0;
+    for(size_t c = 0; c < scene.cameras.size(); ++c) {
+        const Camera& camera = scene.cameras[c];
+        std::vector<Tile> tiles = makeTiles(camera.region(), builder.getOptions().tile_order);
+        for(size_t t = 0; t < tiles.size(); t += TILES_PER_BATCH) {
+            TileBatch batch{static_cast<int>(c), {}};
+            batch.tiles.assign(tiles.begin() + t, tiles.begin() + std::min(tiles.size(), t + TILES_PER_BATCH));
+            pending.push_back(batch);
+        }
+        buffers.push_back(std::make_unique<Framebuffer>(camera.h_res, camera.v_res));
+        remaining_tiles.push_back(tiles.size());
+        total_pixels += camera.region().pixelCount();
+    }
+
+    Progress progress(total_pixels, builder.getOptions().quiet);
+    size_t outstanding = pending.size();
+
+    while(outstanding > 0) {
+        // Hand out work to idle workers
+        for(auto& worker : workers) {
+            if(worker.channel && !worker.assigned && !pending.empty()) {
+                Message message(MessageType::TileBatch);
+                putTiles(message, pending.front());
+                worker.assigned = pending.front();
+                worker.assigned_at = Clock::now();
+                pending.pop_front();
+                if(!worker.channel->send(message)) {
+                    abandonWorker(worker, pending);
+                }
+            }
+        }
+
+        std::vector<pollfd> fds;
+        std::vector<WorkerProcess*> polled;
+        for(auto& worker : workers) {
+            if(worker.channel) {
+                fds.push_back(pollfd{worker.channel->pollHandle(), POLLIN, 0});
+                polled.push_back(&worker);
+            }
+        }
+        if(fds.empty()) {
+            throw std::runtime_error("All render workers died");
+        }
+
+        // Wake up in time to notice the first batch that runs over its timeout
+        Clock::time_point now = Clock::now();
+        Clock::duration wait = batchTimeout();
+        for(WorkerProcess* worker : polled) {
+            if(worker->assigned) {
+                wait = std::min(wait, worker->assigned_at + batchTimeout() - now);
+            }
+        }
+        int wait_ms = static_cast<int>(std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()) + 1);
+
+        if(poll(fds.data(), fds.size(), wait_ms) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("poll failed on worker sockets");
+        }
+
+        for(size_t i = 0; i < fds.size(); ++i) {
+            WorkerProcess& worker = *polled[i];
+            if(fds[i].revents == 0) {
+                // Alive but silent for too long, it is killed and its batch goes back to the queue
+                if(worker.assigned && Clock::now() - worker.assigned_at > batchTimeout()) {
+                    std::cerr << "\nWorker " << worker.pid << " hung, reassigning its tiles" << std::endl;
+                    abandonWorker(worker, pending);
+                }
+                continue;
+            }
+
+            Message message;
+            if(!worker.channel->receive(message) || message.type != MessageType::TileResult) {
+                // Worker died or sent garbage, its batch goes back to the queue
+                std::cerr << "\nWorker " << worker.pid << " lost, reassigning its tiles" << std::endl;
+                abandonWorker(worker, pending);
+                continue;
+            }
+
+            // Parse the whole reply before touching the image, a truncated or foreign one is treated like a lost worker
+            TileBatch batch;
+            RenderStats stats;
+            std::vector<unsigned char> quantized;
+            try {
+                batch = getTiles(message);
+                if(!worker.assigned || batch.camera != worker.assigned->camera || batch.tiles != worker.assigned->tiles) {
+                    throw std::runtime_error("Result does not match the assigned batch");
+                }
+                stats.samples = message.get<int64_t>();
+                stats.primary_rays = message.get<int64_t>();
+                stats.shadow_rays = message.get<int64_t>();
+                stats.reflection_rays = message.get<int64_t>();
+                stats.shadow_cache_lookups = message.get<int64_t>();
+                stats.shadow_cache_hits = message.get<int64_t>();
+
+                // Workers send pixels already quantized, 3 bytes each
+                long long pixels = 0;
+                for(const auto& tile : batch.tiles) {
+                    pixels += tile.pixelCount();
+                }
+                quantized.resize(3 * pixels);
+                for(auto& channel : quantized) {
+                    channel = message.get<uint8_t>();
+                }
+            }
+            catch(const std::exception& e) {
+                std::cerr << "\nWorker " << worker.pid << " sent a bad result (" << e.what() << "), reassigning its tiles" << std::endl;
+                abandonWorker(worker, pending);
+                continue;
+            }
+            slowest_batch = std::max(slowest_batch, Clock::now() - worker.assigned_at);
+
+            Framebuffer& buffer = *buffers[batch.camera];
+            const unsigned char* channel = quantized.data();
+            for(const auto& tile : batch.tiles) {
+                for(int j = tile.y0; j < tile.y1; ++j) {
+                    for(int x = tile.x0; x < tile.x1; ++x, channel += 3) {
+                        buffer.set(x, j, Radiance(channel[0], channel[1], channel[2]));
+                    }
+                }
+            }
+            progress.add(quantized.size() / 3, stats);
+            worker.assigned.reset();
+            outstanding--;
+
+            // Camera done, write it while the rest keeps rendering
+            remaining_tiles[batch.camera] -= batch.tiles.size();
+            if(remaining_tiles[batch.camera] == 0) {
+                writeImage(scene.cameras[batch.camera], buffer);
+                buffer.release();
+            }
+        }
+    }
+
+    progress.finish();
+    shutdownWorkers();
+}
+
+void runRenderWorker(SceneBuilder& builder, Channel& channel) {
+    // Same renderer as a single process render, one wavefront renderer keeps its sort decision across batches
+    std::optional<WavefrontRenderer> wavefront;
+    if(builder.wavefrontRendering()) {
+        wavefront.emplace(builder);
+    }
+
+    Message message;
+    while(channel.receive(message) && message.type == MessageType::TileBatch) {
+        TileBatch batch = getTiles(message);
+
+        Progress progress(0, true);
+        std::vector<Radiance> pixels;
+        const Camera& camera = builder.getScene().cameras[batch.camera];
+        if(wavefront) {
+            wavefront->renderTiles(camera, batch.tiles, pixels, progress);
+        }
+        else {
+            builder.renderTiles(camera, batch.tiles, pixels, progress);
+        }
+
+        Message result(MessageType::TileResult);
+        putTiles(result, batch);
+        RenderStats stats = progress.stats();
+        result.put<int64_t>(stats.samples);
+        result.put<int64_t>(stats.primary_rays);
+        result.put<int64_t>(stats.shadow_rays);
+        result.put<int64_t>(stats.reflection_rays);
+        result.put<int64_t>(stats.shadow_cache_lookups);
+        result.put<int64_t>(stats.shadow_cache_hits);
+        std::vector<unsigned char> quantized(3 * pixels.size());
+        quantizeImage(pixels.data(), pixels.size(), quantized.data());
+        for(unsigned char channel : quantized) {
+            result.put<uint8_t>(channel);
+        }
+        if(!channel.send(result)) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef _COORDINATOR_H
+#define _COORDINATOR_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <chrono>
+
+#include <sys/types.h>
+
+#include "Channel.h"
+#include "../SceneBuilder.h"
+#include "../render/Tile.h"
+
+// Tiles of one camera handed to a worker as a single unit of work
+struct TileBatch {
+    int camera;
+    std::vector<Tile> tiles;
+};
+
+// Renders the scene with several worker processes.
+// Workers are forked after the scene is parsed, each gets a Channel over a Unix
+// domain socket pair and renders tile batches with its own thread pool.
+// Batches held by a worker that dies or stops answering are handed to the remaining
+// workers, and a worker that stops answering is killed.
+class RenderCoordinator {
+public:
+    RenderCoordinator(SceneBuilder& builder, int num_workers);
+    ~RenderCoordinator();
+
+    void exportScene();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct WorkerProcess {
+        pid_t pid;
+        std::unique_ptr<Channel> channel;
+        std::optional<TileBatch> assigned;
+        Clock::time_point assigned_at;
+    };
+
+    void spawnWorkers();
+    // Closes the channel and reaps the process. A graceful retire gives the worker
+    // SHUTDOWN_GRACE to exit on its own, otherwise it is killed right away.
+    void retireWorker(WorkerProcess& worker, bool graceful);
+    void shutdownWorkers();
+    // Puts the worker's batch back at the front of the queue and kills it
+    void abandonWorker(WorkerProcess& worker, std::deque<TileBatch>& pending);
+    // Time a batch may take before its worker counts as hung
+    Clock::duration batchTimeout() const;
+
+    static const int TILES_PER_BATCH = 4;
+    // A batch is given at least MIN_BATCH_TIMEOUT and BATCH_TIMEOUT_FACTOR times the slowest batch so far
+    static constexpr std::chrono::seconds MIN_BATCH_TIMEOUT{30};
+    static const int BATCH_TIMEOUT_FACTOR = 10;
+    static constexpr std::chrono::seconds SHUTDOWN_GRACE{2};
+
+    SceneBuilder& builder;
+    int num_workers;
+    std::vector<WorkerProcess> workers;
+    Clock::duration slowest_batch{0};
+};
+
+// Worker side: renders every batch received on the channel until Shutdown
+void runRenderWorker(SceneBuilder& builder, Channel& channel);
+
+#endif
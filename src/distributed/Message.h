@@ -0,0 +1,64 @@
+#ifndef _MESSAGE_H
+#define _MESSAGE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+enum class MessageType : uint32_t {
+    TileBatch = 1,   // coordinator -> worker: camera index and tiles to render
+    TileResult = 2,  // worker -> coordinator: the same tiles with their pixels
+    Shutdown = 3,    // coordinator -> worker: no more work
+    Request = 4,     // client -> daemon: one text command
+    Response = 5     // daemon -> client: status, then text or pixels
+};
+
+// A typed block of bytes, the unit every Channel sends and receives.
+// Values are stored in host byte order, all processes of a render share one machine.
+struct Message {
+    Message() : type(MessageType::Shutdown), read_pos(0) {}
+    explicit Message(MessageType type) : type(type), read_pos(0) {}
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain values can be serialized");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        payload.insert(payload.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putString(const std::string& value) {
+        put<uint32_t>(value.size());
+        payload.insert(payload.end(), value.begin(), value.end());
+    }
+
+    std::string getString() {
+        uint32_t size = get<uint32_t>();
+        if(read_pos + size > payload.size()) {
+            throw std::runtime_error("Truncated message");
+        }
+        std::string value(payload.data() + read_pos, size);
+        read_pos += size;
+        return value;
+    }
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain values can be serialized");
+        if(read_pos + sizeof(T) > payload.size()) {
+            throw std::runtime_error("Truncated message");
+        }
+        T value;
+        std::memcpy(&value, payload.data() + read_pos, sizeof(T));
+        read_pos += sizeof(T);
+        return value;
+    }
+
+    MessageType type;
+    std::vector<char> payload;
+    size_t read_pos;
+};
+
+#endif
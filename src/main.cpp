@@ -1,27 +1,318 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
 #include "SceneBuilder.h"
+#include "ThreadPool.h"
+#include "Benchmark.h"
+#include "distributed/Coordinator.h"
+#include "daemon/RenderDaemon.h"
+#include "render/DeadlineRenderer.h"
+#include "render/ProgressiveRenderer.h"
+#include "render/PreviewRenderer.h"
 
 using std::cout;
 using std::endl;
 
+void printUsage() {
+    cout << "Usage: ./raytracer.exe [options] [scene-file] [anti-aliasing cycles (default=1)]" << "\n"
+        << "Options:" << "\n"
+        << "  --threads N          number of worker threads (default: one per CPU)" << "\n"
+        << "  --affinity POLICY    pin workers to CPUs: none, compact or scatter (default: none)" << "\n"
+        << "  --numa-replicate     keep a copy of the geometry on every NUMA node" << "\n"
+        << "  --workers N          render with N worker processes, threads are split between them" << "\n"
+        << "  --daemon SOCKET      keep scenes loaded and serve render requests on a Unix socket" << "\n"
+        << "  --gbuffer-cache      daemon: keep the primary hits of the last view, re-render light and material edits from them" << "\n"
+        << "  --time-budget SEC    one full pass, then refine the noisiest tiles until SEC seconds are used" << "\n"
+        << "  --tile-order ORDER   tile and pixel order: scanline, morton or hilbert (default: scanline)" << "\n"
+        << "  --order-report       render once per tile order and compare rays/s and cache misses" << "\n"
+        << "  --crop X0,Y0,X1,Y1   trace only pixels x0 <= x < x1, y0 <= y < y1 of every camera and write that window" << "\n"
+        << "  --crop-fill          with a crop window, write the full size image, black outside the window" << "\n"
+        << "  --sampler NAME       anti aliasing sampler: random, stratified, sobol, halton or r2 (default: random)" << "\n"
+        << "  --sampler-report     compare samplers by the samples per pixel needed for --target-rmse" << "\n"
+        << "  --target-rmse X      RMSE against the reference in 0-255 units (default: 0.5)" << "\n"
+        << "  --edge-aa            trace one center ray per pixel and anti alias only edges and mirrors" << "\n"
+        << "  --adaptive ERROR     adaptive anti aliasing: sample until the standard error of a pixel drops below ERROR" << "\n"
+        << "  --min-spp N          samples per adaptive round (default: 8)" << "\n"
+        << "  --max-spp N          adaptive sample cap per pixel (default: 64)" << "\n"
+        << "  --preview            render every 8th, 4th, 2nd, then every pixel, writing each level as it completes" << "\n"
+        << "  --progressive N      add 1 spp passes into an accumulation buffer, N passes or 0 until Ctrl-C" << "\n"
+        << "  --flush-seconds S    progressive mode: write the current images every S seconds (default: 10)" << "\n"
+        << "  --flush-passes N     progressive mode: write the current images every N passes" << "\n"
+        << "  --packet-size N      trace primary and shadow rays in packets of 1, 4, 8 or 16 (default: 1)" << "\n"
+        << "  --no-frustum         packets: test every ray against BVH nodes, no frustum culling" << "\n"
+        << "  --packet-report      compare rays/s of single rays and packets with and without frustum" << "\n"
+        << "  --wavefront          trace queues of rays through batched intersect, shade and shadow stages" << "\n"
+        << "  --wavefront-report   compare render time and rays/s of the recursive and wavefront renderers" << "\n"
+        << "  --ray-sort MODE      wavefront: sort reflection and shadow rays before traversal: off, on or auto (default: auto)" << "\n"
+        << "  --sort-report        compare wavefront renders with and without ray sorting" << "\n"
+        << "  --reflection-cutoff T stop mirror rays once the product of reflectances is below T (default 0.001)" << "\n"
+        << "  --russian-roulette   continue mirror rays below the cutoff at random with a matching weight" << "\n"
+        << "  --light-cutoff T     skip lights whose intensity / distance^2 at a hit is below T" << "\n"
+        << "  --light-samples K    shade K lights per hit, picked by power / distance^2, instead of every light" << "\n"
+        << "  --no-shadow-cache    do not test the last occluder of each light before traversing shadow rays" << "\n"
+        << "  --ray-report         render normally, then print primary, reflection and shadow ray counts" << "\n"
+        << "  --quiet              no progress or throughput output" << "\n"
+        << "  --scaling-report     render with 1, 2, 4, ... threads and report the speedup" << "\n"
+        << "Example: ./raytracer.exe --threads 8 --affinity compact scene.xml 10" << "\n";
+}
+
 int main(int argc, char *argv[]) {
+    RenderOptions options;
+    std::vector<char*> positional;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if(arg == "--threads" && has_value) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if(arg == "--affinity" && has_value) {
+            if(!parseAffinityPolicy(argv[++i], options.affinity)) {
+                cout << "Unknown affinity policy: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--numa-replicate") {
+            options.replicate_geometry = true;
+        }
+        else if(arg == "--workers" && has_value) {
+            options.workers = atoi(argv[++i]);
+        }
+        else if(arg == "--daemon" && has_value) {
+            options.daemon_socket = argv[++i];
+        }
+        else if(arg == "--gbuffer-cache") {
+            options.gbuffer_cache = true;
+        }
+        else if(arg == "--time-budget" && has_value) {
+            options.time_budget = atof(argv[++i]);
+        }
+        else if(arg == "--tile-order" && has_value) {
+            if(!parseTileOrder(argv[++i], options.tile_order)) {
+                cout << "Unknown tile order: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--order-report") {
+            options.order_report = true;
+        }
+        else if(arg == "--crop" && has_value) {
+            std::istringstream iss(argv[++i]);
+            Tile& crop = options.crop;
+            char sep1, sep2, sep3;
+            if(!(iss >> crop.x0 >> sep1 >> crop.y0 >> sep2 >> crop.x1 >> sep3 >> crop.y1) || crop.width() <= 0 || crop.height() <= 0) {
+                cout << "Expected a crop window x0,y0,x1,y1 but got: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--crop-fill") {
+            options.crop_fill = true;
+        }
+        else if(arg == "--sampler" && has_value) {
+            if(!parseSamplerType(argv[++i], options.sampler)) {
+                cout << "Unknown sampler: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--sampler-report") {
+            options.sampler_report = true;
+        }
+        else if(arg == "--target-rmse" && has_value) {
+            options.target_rmse = atof(argv[++i]);
+        }
+        else if(arg == "--edge-aa") {
+            options.edge_aa = true;
+        }
+        else if(arg == "--adaptive" && has_value) {
+            options.adaptive_threshold = atof(argv[++i]);
+        }
+        else if(arg == "--min-spp" && has_value) {
+            options.min_spp = std::max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--max-spp" && has_value) {
+            options.max_spp = std::max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--preview") {
+            options.preview = true;
+        }
+        else if(arg == "--progressive" && has_value) {
+            options.progressive_passes = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--flush-seconds" && has_value) {
+            options.flush_seconds = atof(argv[++i]);
+        }
+        else if(arg == "--flush-passes" && has_value) {
+            options.flush_passes = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--packet-size" && has_value) {
+            options.packet_size = atoi(argv[++i]);
+            if(options.packet_size != 1 && options.packet_size != 4 && options.packet_size != 8 && options.packet_size != 16) {
+                cout << "Packet size must be 1, 4, 8 or 16\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--no-frustum") {
+            options.packet_frustum = false;
+        }
+        else if(arg == "--packet-report") {
+            options.packet_report = true;
+        }
+        else if(arg == "--wavefront") {
+            options.wavefront = true;
+        }
+        else if(arg == "--wavefront-report") {
+            options.wavefront_report = true;
+        }
+        else if(arg == "--ray-sort" && has_value) {
+            if(!parseRaySortMode(argv[++i], options.ray_sort)) {
+                cout << "Unknown ray sort mode: " << argv[i] << "\n";
+                printUsage();
+                return 1;
+            }
+        }
+        else if(arg == "--sort-report") {
+            options.sort_report = true;
+        }
+        else if(arg == "--reflection-cutoff" && has_value) {
+            options.reflection_cutoff = atof(argv[++i]);
+        }
+        else if(arg == "--russian-roulette") {
+            options.russian_roulette = true;
+        }
+        else if(arg == "--light-cutoff" && has_value) {
+            options.light_cutoff = atof(argv[++i]);
+        }
+        else if(arg == "--light-samples" && has_value) {
+            options.light_samples = std::max(0, atoi(argv[++i]));
+        }
+        else if(arg == "--no-shadow-cache") {
+            options.shadow_cache = false;
+        }
+        else if(arg == "--ray-report") {
+            options.ray_report = true;
+        }
+        else if(arg == "--quiet") {
+            options.quiet = true;
+        }
+        else if(arg == "--scaling-report") {
+            options.scaling_report = true;
+        }
+        else if(arg.rfind("--", 0) == 0) {
+            cout << "Incorrect argument: " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+        else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    // Quiet renders print no throughput, only the reports still read the per-ray counters
+    options.count_rays = !options.quiet || options.scaling_report || options.order_report || options.packet_report || options.sampler_report
+        || options.wavefront_report || options.sort_report || options.ray_report;
+
+    if(!options.daemon_socket.empty() && positional.size() <= 2) {
+        ThreadPool::configure(options.threads, options.affinity);
+        RenderDaemon daemon(options.daemon_socket, options);
+
+        // The scene on the command line is served as "default"
+        if(!positional.empty()) {
+            auto builder = std::make_unique<SceneBuilder>();
+            builder->setAntiAliasing(positional.size() > 1 ? atoi(positional[1]) : 1);
+            builder->setOptions(options);
+            builder->importScene(positional[0]);
+            daemon.addScene("default", std::move(builder));
+        }
+        daemon.run();
+        return 0;
+    }
 
-    if(argc < 2 || argc > 3) {
-        cout << "Incorrect argument\n"
-            << "Usage: ./tracer.exe [scene-file] [anti-aliasing cycles (default=1)]" << "\n"
-            << "Example: ./tracer.exe scene.xml 10" << "\n";
+    if(positional.size() < 1 || positional.size() > 2) {
+        cout << "Incorrect argument\n";
+        printUsage();
         return 1;
     }
 
-    int aadepth = argv[2] ? atoi(argv[2]) : 1;
+    int aadepth = positional.size() > 1 ? atoi(positional[1]) : 1;
+
+    ThreadPool::configure(options.threads, options.affinity);
 
     SceneBuilder b;
     b.setAntiAliasing(aadepth);
+    b.setOptions(options);
     cout << "Importing xml...\n";
-    b.importScene(argv[1]);
+    b.importScene(positional[0]);
     cout << "XML imported.\n";
 
     b.printScene();
+
+    if(options.scaling_report) {
+        reportScaling(b);
+        return 0;
+    }
+
+    if(options.order_report) {
+        reportTileOrders(b);
+        return 0;
+    }
+
+    if(options.packet_report) {
+        reportPackets(b);
+        return 0;
+    }
+
+    if(options.sort_report) {
+        reportRaySorting(b);
+        return 0;
+    }
+
+    if(options.wavefront_report) {
+        reportWavefront(b);
+        return 0;
+    }
+
+    if(options.sampler_report) {
+        reportSamplers(b, options.target_rmse);
+        return 0;
+    }
+
+    if(options.preview) {
+        PreviewRenderer renderer(b);
+        renderer.exportScene();
+        return 0;
+    }
+
+    if(options.progressive_passes >= 0) {
+        ProgressiveRenderer renderer(b, options.progressive_passes, options.flush_seconds, options.flush_passes);
+        renderer.exportScene();
+        return 0;
+    }
+
+    if(options.time_budget > 0) {
+        DeadlineRenderer renderer(b, options.time_budget);
+        renderer.exportScene();
+        return 0;
+    }
+
+    if(options.workers > 0) {
+        RenderCoordinator coordinator(b, options.workers);
+        coordinator.exportScene();
+        return 0;
+    }
+
+    if(options.ray_report) {
+        reportRays(b);
+        return 0;
+    }
+
     b.exportScene();
 
     return 0;
@@ -0,0 +1,60 @@
+#ifndef _ACCUMULATOR_H
+#define _ACCUMULATOR_H
+
+#include <vector>
+#include "Radiance.h"
+#include "../Vector.h"
+
+// Running sum of the samples of one pixel
+struct PixelEstimate {
+    Color sum;
+    double luminance_sum = 0;
+    double luminance_sq_sum = 0;
+    int samples = 0;
+
+    inline void add(const Radiance& c) {
+        sum += c.color();
+        double l = luminance(c);
+        luminance_sum += l;
+        luminance_sq_sum += l * l;
+        samples++;
+    }
+
+    inline Radiance mean() const {
+        if(samples == 0) {
+            return Radiance();
+        }
+        return Radiance(sum / samples);
+    }
+
+    inline double luminanceMean() const {return samples ? luminance_sum / samples : 0;}
+
+    // Unbiased sample variance of the luminance, needs 2 samples
+    inline double variance() const {
+        if(samples < 2) {
+            return 0;
+        }
+        double m = luminance_sum / samples;
+        return std::max(0.0, (luminance_sq_sum - samples * m * m) / (samples - 1));
+    }
+
+    static inline double luminance(const Radiance& c) {return 0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b;}
+};
+
+// Per-pixel estimates of a whole image, used by renderers that sample pixels more than once
+class Accumulator {
+public:
+    Accumulator(int width, int height) : w(width), h(height), pixels(static_cast<size_t>(width) * height) {}
+
+    inline PixelEstimate& at(int x, int y) {return pixels[static_cast<size_t>(y) * w + x];}
+    inline const PixelEstimate& at(int x, int y) const {return pixels[static_cast<size_t>(y) * w + x];}
+
+    inline int width() const {return w;}
+    inline int height() const {return h;}
+
+private:
+    int w, h;
+    std::vector<PixelEstimate> pixels;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+
+#include "DeadlineRenderer.h"
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "Sampler.h"
+#include "RenderStats.h"
+#include "../ThreadPool.h"
+#include "../Progress.h"
+
+using std::cout;
+
+DeadlineRenderer::DeadlineRenderer(SceneBuilder& builder, double budget_seconds) : builder(builder), budget_seconds(budget_seconds) {
+}
+
+void DeadlineRenderer::refineTile(CameraState& state, const Tile& tile, int samples_per_pixel, bool ignore_deadline, Progress& progress) {
+    RenderStats& stats = localStats();
+    RenderStats before = stats;
+    const Sampler& sampler = getSampler(builder.getOptions().sampler);
+
+    for(int j = tile.y0; j < tile.y1; ++j) {
+        // Rows are short enough to keep the overshoot small
+        if(!ignore_deadline && Clock::now() >= deadline) {
+            break;
+        }
+        for(int i = tile.x0; i < tile.x1; ++i) {
+            PixelEstimate& estimate = state.estimates.at(i, j);
+            // The first pass is batch 0, refinement batch b takes indices b * count .. b * count + count - 1.
+            // Stratified samplers see whole batches and sequence samplers never repeat an index.
+            const int batch = estimate.samples == 0 ? 0 : 1 + (estimate.samples - 1) / samples_per_pixel;
+            for(int k = 0; k < samples_per_pixel; ++k) {
+                double u, v;
+                sampler.sample(i, j, batch * samples_per_pixel + k, samples_per_pixel, u, v);
+                estimate.add(builder.sample(state.rays, i + u, j + v));
+            }
+            if(builder.getOptions().count_rays) {
+                stats.samples += samples_per_pixel;
+            }
+        }
+    }
+
+    progress.add(ignore_deadline ? tile.pixelCount() : 0, stats - before);
+}
+
+// Sum of the per-pixel variance of the mean. Pixels with a single sample have no variance
+// yet, the difference to their neighbours stands in for it.
+double DeadlineRenderer::tileError(const CameraState& state, const Tile& tile) const {
+    const Accumulator& estimates = state.estimates;
+    // Pixels outside a crop window are never rendered, only neighbours inside it count
+    const Tile region = state.rays.getCamera().region();
+    double error = 0;
+    for(int j = tile.y0; j < tile.y1; ++j) {
+        for(int i = tile.x0; i < tile.x1; ++i) {
+            const PixelEstimate& estimate = estimates.at(i, j);
+            double variance = estimate.variance();
+            if(estimate.samples < 2) {
+                double m = estimate.luminanceMean();
+                double dx = i + 1 < region.x1 ? estimates.at(i + 1, j).luminanceMean() - m : 0;
+                double dy = j + 1 < region.y1 ? estimates.at(i, j + 1).luminanceMean() - m : 0;
+                variance = 0.5 * (dx * dx + dy * dy);
+            }
+            error += variance / std::max(1, estimate.samples);
+        }
+    }
+    return error;
+}
+
+void DeadlineRenderer::exportScene() {
+    const Scene& scene = builder.getScene();
+    Clock::time_point start = Clock::now();
+    deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(budget_seconds));
+
+    std::vector<std::unique_ptr<CameraState>> states;
+    long long total_pixels = 0;
+    for(const auto& camera : scene.cameras) {
+        states.push_back(std::make_unique<CameraState>(camera, builder.getOptions().tile_order));
+        total_pixels += camera.region().pixelCount();
+    }
+
+    Progress progress(total_pixels, builder.getOptions().quiet);
+
+    // First pass: one sample everywhere, whatever the budget says
+    {
+        TaskGroup tasks;
+        for(auto& state : states) {
+            for(const auto& tile : state->tiles) {
+                tasks.run([&, state = state.get()]() {
+                    refineTile(*state, tile, 1, true, progress);
+                });
+            }
+        }
+        tasks.wait();
+    }
+
+    // (camera, tile) pairs sorted by error on every round
+    std::vector<std::pair<int, int>> order;
+    for(size_t c = 0; c < states.size(); ++c) {
+        for(size_t t = 0; t < states[c]->tiles.size(); ++t) {
+            states[c]->errors[t] = tileError(*states[c], states[c]->tiles[t]);
+            order.push_back({static_cast<int>(c), static_cast<int>(t)});
+        }
+    }
+
+    // Refinement rounds: the noisiest tiles get more samples until time runs out
+    const size_t tiles_per_round = std::max<size_t>(1, ThreadPool::instance().size() * 2);
+    int rounds = 0;
+    while(Clock::now() < deadline && !order.empty()) {
+        size_t count = std::min(tiles_per_round, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](const auto& a, const auto& b) {
+            return states[a.first]->errors[a.second] > states[b.first]->errors[b.second];
+        });
+        if(states[order[0].first]->errors[order[0].second] <= 0) {
+            break;
+        }
+
+        TaskGroup tasks;
+        for(size_t k = 0; k < count; ++k) {
+            CameraState* state = states[order[k].first].get();
+            int t = order[k].second;
+            tasks.run([&, state, t]() {
+                refineTile(*state, state->tiles[t], SAMPLES_PER_REFINEMENT, false, progress);
+            });
+        }
+        tasks.wait();
+
+        // tileError reads pixels of neighbouring tiles, only once no tile is being refined
+        for(size_t k = 0; k < count; ++k) {
+            CameraState* state = states[order[k].first].get();
+            int t = order[k].second;
+            tasks.run([&, state, t]() {
+                state->errors[t] = tileError(*state, state->tiles[t]);
+            });
+        }
+        tasks.wait();
+        rounds++;
+    }
+
+    std::chrono::duration<double> render_time = Clock::now() - start;
+    progress.finish();
+
+    // Best image available and the sampling it got
+    for(auto& state : states) {
+        const Camera& camera = state->rays.getCamera();
+        const Tile region = camera.region();
+        Framebuffer buffer(camera.h_res, camera.v_res);
+        int min_spp = INT_MAX, max_spp = 0;
+        long long total_spp = 0;
+        for(int j = region.y0; j < region.y1; ++j) {
+            for(int i = region.x0; i < region.x1; ++i) {
+                const PixelEstimate& estimate = state->estimates.at(i, j);
+                buffer.set(i, j, estimate.mean());
+                min_spp = std::min(min_spp, estimate.samples);
+                max_spp = std::max(max_spp, estimate.samples);
+                total_spp += estimate.samples;
+            }
+        }
+        writeImage(camera, buffer);
+
+        if(!builder.getOptions().quiet) {
+            cout << camera.image_name << ": spp min " << min_spp << " avg " << std::fixed << std::setprecision(2)
+                 << static_cast<double>(total_spp) / region.pixelCount() << std::defaultfloat << " max " << max_spp << "\n";
+        }
+    }
+
+    if(!builder.getOptions().quiet) {
+        cout << "Time budget " << budget_seconds << "s, rendered in " << render_time.count() << "s with " << rounds << " refinement rounds\n";
+    }
+}
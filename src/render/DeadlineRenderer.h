@@ -0,0 +1,45 @@
+#ifndef _DEADLINERENDERER_H
+#define _DEADLINERENDERER_H
+
+#include <chrono>
+#include <vector>
+#include <memory>
+
+#include "Tile.h"
+#include "Accumulator.h"
+#include "../SceneBuilder.h"
+
+// Renders every camera within a fixed wall-clock budget.
+// One sample per pixel is always taken first, the rest of the budget goes to the
+// tiles with the highest estimated error. Images hold the mean of whatever
+// samples were taken when the deadline hits.
+class DeadlineRenderer {
+public:
+    DeadlineRenderer(SceneBuilder& builder, double budget_seconds);
+
+    void exportScene();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct CameraState {
+        CameraState(const Camera& camera, TileOrder order) : rays(camera), estimates(camera.h_res, camera.v_res), tiles(makeTiles(camera.region(), order)), errors(tiles.size(), 0) {}
+
+        RayGenerator rays;
+        Accumulator estimates;
+        std::vector<Tile> tiles;
+        std::vector<double> errors;
+    };
+
+    // Adds samples_per_pixel samples to every pixel of the tile, stops early at the deadline
+    void refineTile(CameraState& state, const Tile& tile, int samples_per_pixel, bool ignore_deadline, Progress& progress);
+    double tileError(const CameraState& state, const Tile& tile) const;
+
+    static const int SAMPLES_PER_REFINEMENT = 4;
+
+    SceneBuilder& builder;
+    double budget_seconds;
+    Clock::time_point deadline;
+};
+
+#endif
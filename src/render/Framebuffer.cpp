@@ -0,0 +1,35 @@
+#include <new>
+#include <algorithm>
+#include "Framebuffer.h"
+
+Framebuffer::Framebuffer(int width, int height, int tile_size) : w(width), h(height), tile_size(tile_size) {
+    // malloc instead of new[], Radiance() would touch every page on the allocating thread
+    Radiance* memory = static_cast<Radiance*>(std::malloc(sizeof(Radiance) * std::max(1, w * h)));
+    if(!memory) {
+        throw std::bad_alloc();
+    }
+    pixels.reset(memory);
+}
+
+std::vector<unsigned char> Framebuffer::encode() const {
+    return encode(Tile{0, 0, w, h});
+}
+
+std::vector<unsigned char> Framebuffer::encode(const Tile& region) const {
+    const int width = region.width();
+    std::vector<unsigned char> image(static_cast<size_t>(width) * region.height() * 3);
+
+    // A row of a tile is contiguous in both layouts, quantize it in one run
+    for(int y = region.y0; y < region.y1; ++y) {
+        for(int x = region.x0; x < region.x1;) {
+            int run = std::min((x / tile_size + 1) * tile_size, region.x1) - x;
+            quantizeImage(&get(x, y), run, &image[(static_cast<size_t>(y - region.y0) * width + (x - region.x0)) * 3]);
+            x += run;
+        }
+    }
+    return image;
+}
+
+void Framebuffer::release() {
+    pixels.reset();
+}
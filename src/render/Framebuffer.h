@@ -0,0 +1,52 @@
+#ifndef _FRAMEBUFFER_H
+#define _FRAMEBUFFER_H
+
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Tile.h"
+#include "Radiance.h"
+
+// Image stored tile by tile, so every tile owns a contiguous block of memory.
+// Pixels are left untouched on allocation, the first write happens on the worker
+// that renders the tile, which places its pages on that worker's NUMA node.
+// Pixels hold linear float radiance until the image is encoded, after which the
+// owner releases them and keeps only the 8 bit image.
+class Framebuffer {
+public:
+    Framebuffer(int width, int height, int tile_size = TILE_SIZE);
+
+    inline void set(int x, int y, const Radiance& c) {pixels.get()[index(x, y)] = c;}
+    inline const Radiance& get(int x, int y) const {return pixels.get()[index(x, y)];}
+
+    inline int width() const {return w;}
+    inline int height() const {return h;}
+
+    // Clamps and quantizes the image to row-major 8 bit RGB, 3 bytes per pixel
+    std::vector<unsigned char> encode() const;
+    // Same for the pixels inside region only, region.width() pixels per row
+    std::vector<unsigned char> encode(const Tile& region) const;
+
+    // Returns the memory to the OS once the image has been written
+    void release();
+
+private:
+    struct FreeDeleter {
+        void operator ()(void* p) const {std::free(p);}
+    };
+
+    inline size_t index(int x, int y) const {
+        int tx = x / tile_size, ty = y / tile_size;
+        int tile_w = std::min(tile_size, w - tx * tile_size);
+        int tile_h = std::min(tile_size, h - ty * tile_size);
+        size_t tile_offset = static_cast<size_t>(ty) * tile_size * w + static_cast<size_t>(tx) * tile_size * tile_h;
+        return tile_offset + (y - ty * tile_size) * tile_w + (x - tx * tile_size);
+    }
+
+    int w, h, tile_size;
+    std::unique_ptr<Radiance[], FreeDeleter> pixels;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "GBuffer.h"
+
+static bool sameVector(const Vector& a, const Vector& b) {
+    return a.x() == b.x() && a.y() == b.y() && a.z() == b.z();
+}
+
+// Everything RayGenerator uses, the id and image name do not change the rays
+static bool sameView(const Camera& a, const Camera& b) {
+    return sameVector(a.position, b.position) && sameVector(a.gaze, b.gaze) && sameVector(a.up, b.up)
+        && a.left == b.left && a.right == b.right && a.bottom == b.bottom && a.top == b.top
+        && a.near_distance == b.near_distance && a.h_res == b.h_res && a.v_res == b.v_res;
+}
+
+bool GBuffer::matches(const Camera& camera, const std::vector<Tile>& tiles, int samples_per_pixel) const {
+    if(!valid || samples_per_pixel != this->samples_per_pixel || tiles.size() != this->tiles.size() || !sameView(camera, this->camera)) {
+        return false;
+    }
+    for(size_t t = 0; t < tiles.size(); ++t) {
+        const Tile& a = tiles[t];
+        const Tile& b = this->tiles[t];
+        if(a.x0 != b.x0 || a.y0 != b.y0 || a.x1 != b.x1 || a.y1 != b.y1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void GBuffer::reset(const Camera& camera, const std::vector<Tile>& tiles, int samples_per_pixel) {
+    valid = false;
+    this->camera = camera;
+    this->tiles = tiles;
+    this->samples_per_pixel = samples_per_pixel;
+
+    offsets.clear();
+    size_t total = 0;
+    for(const auto& tile : tiles) {
+        offsets.push_back(total);
+        total += static_cast<size_t>(tile.pixelCount()) * samples_per_pixel;
+    }
+    samples.resize(total);
+}
+
+void GBuffer::clear() {
+    valid = false;
+    tiles.clear();
+    offsets.clear();
+    samples.clear();
+    samples.shrink_to_fit();
+}
@@ -0,0 +1,47 @@
+#ifndef _GBUFFER_H
+#define _GBUFFER_H
+
+#include <vector>
+#include <cstddef>
+
+#include "Tile.h"
+#include "../Ray.h"
+#include "../scene/Camera.h"
+
+// Primary hit of one camera sample, everything shading needs without tracing the camera ray again
+struct GBufferSample {
+    Ray ray;
+    double t;
+    Point position;
+    Vector normal;
+    int object;     // -1 if the camera ray hit nothing
+    int material;   // Index into scene.materials
+};
+
+// Primary hits of every sample of a set of tiles, kept between renders of the same view.
+// Light and material edits only change shading, so a render of the cached view skips its
+// camera rays and starts at shading. Anything that moves geometry has to clear it.
+class GBuffer {
+public:
+    // True if the buffer holds the hits of exactly this view
+    bool matches(const Camera& camera, const std::vector<Tile>& tiles, int samples_per_pixel) const;
+    // Sizes the buffer for a new view, the caller fills in the hits tile by tile.
+    // The buffer matches nothing until markFilled, so a fill cut short by an error is never reused.
+    void reset(const Camera& camera, const std::vector<Tile>& tiles, int samples_per_pixel);
+    void markFilled() {valid = true;}
+    void clear();
+
+    // Samples of tile t, pixels row by row and samples_per_pixel samples each
+    GBufferSample* tileSamples(size_t t) {return &samples[offsets[t]];}
+    size_t bytes() const {return samples.capacity() * sizeof(GBufferSample);}
+
+private:
+    bool valid = false;
+    Camera camera;
+    std::vector<Tile> tiles;
+    int samples_per_pixel = 0;
+    std::vector<size_t> offsets;
+    std::vector<GBufferSample> samples;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+
+#include "ImageWriter.h"
+
+// Writes width x height row-major 8 bit RGB as ppm
+static void writePPM(const std::string& name, int width, int height, const std::vector<unsigned char>& pixels) {
+    std::ostringstream image;
+
+    // ppm header
+    image << "P3" << "\n";
+    image << width << " " << height << "\n";
+    image << "255" << "\n";
+
+    for (size_t i = 0; i + 2 < pixels.size(); i += 3) {
+        image << static_cast<int>(pixels[i]) << " " << static_cast<int>(pixels[i + 1]) << " " << static_cast<int>(pixels[i + 2]) << "\n";
+    }
+
+    // Written next to the target and renamed, a viewer polling a progressive render never sees half an image
+    std::string temp_name = name + ".tmp";
+    {
+        std::ofstream out(temp_name, std::ios::binary | std::ios::out);
+        out << image.str();
+    }
+    std::rename(temp_name.c_str(), name.c_str());
+}
+
+// Writes the pixels of the camera's crop window, region.width() per row, as a cropped
+// image or placed in a black full size image
+static void writeRegion(const Camera& camera, const Tile& region, const std::vector<unsigned char>& pixels) {
+    if (!camera.crop_fill) {
+        writePPM(camera.image_name, region.width(), region.height(), pixels);
+        return;
+    }
+
+    std::vector<unsigned char> image(static_cast<size_t>(camera.h_res) * camera.v_res * 3, 0);
+    const size_t row_bytes = static_cast<size_t>(region.width()) * 3;
+    for (int y = region.y0; y < region.y1; ++y) {
+        std::copy_n(&pixels[(y - region.y0) * row_bytes], row_bytes, &image[(static_cast<size_t>(y) * camera.h_res + region.x0) * 3]);
+    }
+    writePPM(camera.image_name, camera.h_res, camera.v_res, image);
+}
+
+void writeImage(const Camera& camera, const Framebuffer& buffer) {
+    // Pixels outside the crop window were never rendered, only the window is encoded
+    const Tile region = camera.region();
+    writeRegion(camera, region, buffer.encode(region));
+}
+
+void writeImage(const Camera& camera, const std::vector<unsigned char>& pixels) {
+    const Tile region = camera.region();
+    if (region.pixelCount() == static_cast<int>(camera.h_res * camera.v_res)) {
+        writePPM(camera.image_name, camera.h_res, camera.v_res, pixels);
+        return;
+    }
+
+    std::vector<unsigned char> window(static_cast<size_t>(region.pixelCount()) * 3);
+    const size_t row_bytes = static_cast<size_t>(region.width()) * 3;
+    for (int y = region.y0; y < region.y1; ++y) {
+        std::copy_n(&pixels[(static_cast<size_t>(y) * camera.h_res + region.x0) * 3], row_bytes, &window[(y - region.y0) * row_bytes]);
+    }
+    writeRegion(camera, region, window);
+}
+
+std::string imageName(const Camera& camera, const std::string& suffix) {
+    std::string name = camera.image_name;
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos && name.find('/', dot) == std::string::npos) {
+        name.erase(dot);
+    }
+    return name + suffix;
+}
+
+void writeSampleMap(const Camera& camera, const std::vector<unsigned short>& sample_counts, int max_spp) {
+    std::ostringstream image;
+
+    // pgm header
+    image << "P2" << "\n";
+    image << camera.h_res << " " << camera.v_res << "\n";
+    image << "255" << "\n";
+
+    max_spp = std::max(1, max_spp);
+    for (size_t i = 0; i < sample_counts.size(); ++i) {
+        image << std::min(255, sample_counts[i] * 255 / max_spp) << ((i + 1) % camera.h_res ? " " : "\n");
+    }
+
+    std::ofstream out(imageName(camera, "_spp.pgm"), std::ios::binary | std::ios::out);
+    out << image.str();
+}
@@ -0,0 +1,22 @@
+#ifndef _IMAGEWRITER_H
+#define _IMAGEWRITER_H
+
+#include <vector>
+#include <string>
+
+#include "Framebuffer.h"
+#include "../scene/Camera.h"
+
+// Encodes the framebuffer as ppm and writes it to camera.image_name.
+// With a crop window only the window is written, or a full size image if camera.crop_fill is set.
+void writeImage(const Camera& camera, const Framebuffer& buffer);
+// Same for a full size image already quantized to row-major 8 bit RGB
+void writeImage(const Camera& camera, const std::vector<unsigned char>& pixels);
+
+// camera.image_name with its extension replaced by suffix, for files written next to the image
+std::string imageName(const Camera& camera, const std::string& suffix);
+
+// Writes samples per pixel as a grayscale pgm next to the image (name_spp.pgm), white = max_spp
+void writeSampleMap(const Camera& camera, const std::vector<unsigned short>& sample_counts, int max_spp);
+
+#endif
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "PreviewRenderer.h"
+#include "ImageWriter.h"
+#include "Sampler.h"
+#include "RenderStats.h"
+#include "../ThreadPool.h"
+#include "../Progress.h"
+
+using std::cout;
+
+PreviewRenderer::PreviewRenderer(SceneBuilder& builder) : builder(builder) {
+}
+
+// Reduced images hold one pixel per step x step block, the block's top left pixel
+static int levelSize(int extent, int step) {
+    return (extent + step - 1) / step;
+}
+
+void PreviewRenderer::renderLevel(CameraState& state, const Tile& tile, int step, Progress& progress) {
+    RenderStats& stats = localStats();
+    RenderStats before = stats;
+    const Sampler& sampler = getSampler(builder.getOptions().sampler);
+    const int count = builder.getAntiAliasing();
+    const int coarser = 2 * step;
+    long long pixels = 0;
+
+    // The grid starts at the region's corner, a crop window previews like a full image
+    const Tile& region = state.region;
+    int first_x = tile.x0 + (step - (tile.x0 - region.x0) % step) % step;
+    int first_y = tile.y0 + (step - (tile.y0 - region.y0) % step) % step;
+    for(int j = first_y; j < tile.y1; j += step) {
+        for(int i = first_x; i < tile.x1; i += step) {
+            if(step < COARSEST_STEP && (i - region.x0) % coarser == 0 && (j - region.y0) % coarser == 0) {
+                continue;
+            }
+
+            // Same samples as a uniform render, the final level matches it
+            Color color(0, 0, 0);
+            for(int k = 0; k < count; ++k) {
+                double u, v;
+                sampler.sample(i, j, k, count, u, v);
+                color += builder.sample(state.rays, i + u, j + v).color();
+            }
+            state.buffer.set(i, j, Radiance(color / count));
+            pixels++;
+        }
+    }
+    if(builder.getOptions().count_rays) {
+        stats.samples += pixels * count;
+    }
+    progress.add(pixels, stats - before);
+}
+
+void PreviewRenderer::writeLevel(const CameraState& state, int step) const {
+    const Camera& camera = state.rays.getCamera();
+    if(step == 1) {
+        writeImage(camera, state.buffer);
+        return;
+    }
+
+    const Tile& region = state.region;
+    Camera reduced = camera;
+    reduced.h_res = levelSize(region.width(), step);
+    reduced.v_res = levelSize(region.height(), step);
+    reduced.crop = Tile{0, 0, 0, 0};
+    reduced.crop_fill = false;
+    reduced.image_name = imageName(camera, "_preview" + std::to_string(step) + ".ppm");
+
+    std::vector<Radiance> pixels;
+    pixels.reserve(static_cast<size_t>(reduced.h_res) * reduced.v_res);
+    for(int j = region.y0; j < region.y1; j += step) {
+        for(int i = region.x0; i < region.x1; i += step) {
+            pixels.push_back(state.buffer.get(i, j));
+        }
+    }
+    std::vector<unsigned char> image(3 * pixels.size());
+    quantizeImage(pixels.data(), pixels.size(), image.data());
+    writeImage(reduced, image);
+}
+
+void PreviewRenderer::exportScene() {
+    const Scene& scene = builder.getScene();
+    const RenderOptions& options = builder.getOptions();
+
+    std::vector<CameraState> states;
+    states.reserve(scene.cameras.size());
+    long long total_pixels = 0;
+    for(const auto& camera : scene.cameras) {
+        states.emplace_back(camera, options.tile_order);
+        total_pixels += camera.region().pixelCount();
+    }
+
+    // Levels take milliseconds at first, they report in one line each instead of a progress bar
+    Progress progress(total_pixels, true);
+    for(int step = COARSEST_STEP; step >= 1; step /= 2) {
+        TaskGroup tasks;
+        for(auto& state : states) {
+            for(const auto& tile : state.tiles) {
+                tasks.run([&, state = &state]() {
+                    renderLevel(*state, tile, step, progress);
+                });
+            }
+        }
+        tasks.wait();
+
+        for(auto& state : states) {
+            tasks.run([&, state = &state]() {
+                writeLevel(*state, step);
+            });
+        }
+        tasks.wait();
+
+        if(!options.quiet) {
+            cout << "Preview 1/" << step << " written after " << std::fixed << std::setprecision(1) << progress.elapsedSeconds() * 1000
+                 << " ms, " << progress.rays() << " rays so far\n" << std::defaultfloat;
+        }
+    }
+    progress.finish();
+}
@@ -0,0 +1,43 @@
+#ifndef _PREVIEWRENDERER_H
+#define _PREVIEWRENDERER_H
+
+#include <vector>
+
+#include "Tile.h"
+#include "Framebuffer.h"
+#include "RayGenerator.h"
+#include "../SceneBuilder.h"
+
+// Renders every camera in levels of decreasing pixel spacing, every 8th pixel in both
+// directions first, then every 4th, 2nd and finally all of them. A level only traces
+// the pixels no coarser level traced, so the last level costs what the remaining pixels
+// cost and the whole render traces each pixel once. Each level is written as soon as
+// it completes, coarse levels as reduced images next to the final one (name_preview8.ppm).
+class PreviewRenderer {
+public:
+    explicit PreviewRenderer(SceneBuilder& builder);
+
+    void exportScene();
+
+private:
+    // Pixel spacing of the first level, halved every level down to 1
+    static const int COARSEST_STEP = 8;
+
+    struct CameraState {
+        CameraState(const Camera& camera, TileOrder order) : rays(camera), buffer(camera.h_res, camera.v_res), region(camera.region()), tiles(makeTiles(region, order)) {}
+
+        RayGenerator rays;
+        Framebuffer buffer;
+        Tile region;
+        std::vector<Tile> tiles;
+    };
+
+    // Traces the pixels of the tile on the step grid that are not on the grid of the previous level
+    void renderLevel(CameraState& state, const Tile& tile, int step, Progress& progress);
+    // Writes the pixels on the step grid as a reduced image, the full image for step 1
+    void writeLevel(const CameraState& state, int step) const;
+
+    SceneBuilder& builder;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <csignal>
+
+#include "ProgressiveRenderer.h"
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "Sampler.h"
+#include "RenderStats.h"
+#include "../ThreadPool.h"
+#include "../Progress.h"
+
+using std::cout;
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int) {
+    interrupted = 1;
+}
+
+ProgressiveRenderer::ProgressiveRenderer(SceneBuilder& builder, int max_passes, double flush_seconds, int flush_passes)
+    : builder(builder), max_passes(max_passes), flush_seconds(flush_seconds), flush_passes(flush_passes) {
+}
+
+void ProgressiveRenderer::renderPass(CameraState& state, const Tile& tile, int pass, Progress& progress) {
+    RenderStats& stats = localStats();
+    RenderStats before = stats;
+    const Sampler& sampler = getSampler(builder.getOptions().sampler);
+    const int width = state.rays.getCamera().h_res;
+
+    for(int j = tile.y0; j < tile.y1; ++j) {
+        for(int i = tile.x0; i < tile.x1; ++i) {
+            double u, v;
+            // Passes of a bounded render form one stratified set
+            sampler.sample(i, j, pass, std::max(1, max_passes), u, v);
+            state.sums[static_cast<size_t>(j) * width + i] += builder.sample(state.rays, i + u, j + v);
+        }
+    }
+    if(builder.getOptions().count_rays) {
+        stats.samples += tile.pixelCount();
+    }
+
+    // An open ended render reports the first pass as done
+    progress.add(max_passes > 0 || pass == 0 ? tile.pixelCount() : 0, stats - before);
+}
+
+void ProgressiveRenderer::flush(const std::vector<CameraState>& states, int passes) const {
+    TaskGroup tasks;
+    for(const auto& state : states) {
+        tasks.run([&]() {
+            const Camera& camera = state.rays.getCamera();
+            // Sums are already row-major, the mean is quantized straight into the image
+            float scale = 1.0f / passes;
+            std::vector<Radiance> mean(state.sums.size());
+            for(size_t i = 0; i < mean.size(); ++i) {
+                mean[i] = state.sums[i] * scale;
+            }
+            std::vector<unsigned char> image(3 * mean.size());
+            quantizeImage(mean.data(), mean.size(), image.data());
+            writeImage(camera, image);
+        });
+    }
+    tasks.wait();
+}
+
+void ProgressiveRenderer::exportScene() {
+    const Scene& scene = builder.getScene();
+    const RenderOptions& options = builder.getOptions();
+
+    std::vector<CameraState> states;
+    states.reserve(scene.cameras.size());
+    long long total_pixels = 0;
+    for(const auto& camera : scene.cameras) {
+        states.emplace_back(camera, options.tile_order);
+        total_pixels += camera.region().pixelCount();
+    }
+
+    interrupted = 0;
+    auto previous_handler = std::signal(SIGINT, onInterrupt);
+
+    Progress progress(total_pixels * std::max(1, max_passes), options.quiet);
+    Clock::time_point last_flush = Clock::now();
+    int passes = 0;
+    int flushed_passes = 0;
+
+    while(!interrupted && (max_passes == 0 || passes < max_passes)) {
+        TaskGroup tasks;
+        for(auto& state : states) {
+            for(const auto& tile : state.tiles) {
+                tasks.run([&, state = &state]() {
+                    renderPass(*state, tile, passes, progress);
+                });
+            }
+        }
+        tasks.wait();
+        passes++;
+
+        std::chrono::duration<double> since_flush = Clock::now() - last_flush;
+        bool flush_due = (flush_passes > 0 && passes % flush_passes == 0) || (flush_seconds > 0 && since_flush.count() >= flush_seconds);
+        if(flush_due) {
+            flush(states, passes);
+            flushed_passes = passes;
+            last_flush = Clock::now();
+        }
+    }
+
+    progress.finish();
+    if(passes > 0 && flushed_passes != passes) {
+        flush(states, passes);
+    }
+    std::signal(SIGINT, previous_handler);
+
+    if(!options.quiet) {
+        cout << "Progressive render " << (interrupted ? "stopped" : "finished") << " after " << passes << " passes ("
+             << std::fixed << std::setprecision(2) << progress.elapsedSeconds() << std::defaultfloat << "s)\n";
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef _PROGRESSIVERENDERER_H
+#define _PROGRESSIVERENDERER_H
+
+#include <chrono>
+#include <vector>
+
+#include "Tile.h"
+#include "Radiance.h"
+#include "../SceneBuilder.h"
+
+// Renders one sample per pixel per pass over every camera and keeps adding passes
+// into a float accumulation buffer. The current mean is written to disk every few
+// seconds or passes, so a render can be inspected and stopped once it looks good.
+// SIGINT finishes the running pass, writes the images and returns.
+class ProgressiveRenderer {
+public:
+    // max_passes 0 renders until interrupted
+    ProgressiveRenderer(SceneBuilder& builder, int max_passes, double flush_seconds, int flush_passes);
+
+    void exportScene();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct CameraState {
+        CameraState(const Camera& camera, TileOrder order) : rays(camera), sums(static_cast<size_t>(camera.h_res) * camera.v_res), tiles(makeTiles(camera.region(), order)) {}
+
+        RayGenerator rays;
+        std::vector<Radiance> sums; // Running radiance sums, row-major
+        std::vector<Tile> tiles;
+    };
+
+    // Adds one sample to every pixel of the tile
+    void renderPass(CameraState& state, const Tile& tile, int pass, Progress& progress);
+    // Writes the mean of the passes done so far for every camera
+    void flush(const std::vector<CameraState>& states, int passes) const;
+
+    SceneBuilder& builder;
+    int max_passes;
+    double flush_seconds;
+    int flush_passes;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _RADIANCE_H
+#define _RADIANCE_H
+
+#include <algorithm>
+#include <cstddef>
+
+#include "../Vector.h"
+
+// Linear radiance in the scene's 0-255 display units. Values are never clamped while
+// rendering, only when the image is quantized for output.
+struct Radiance {
+    float r = 0, g = 0, b = 0;
+
+    Radiance() = default;
+    Radiance(float _r, float _g, float _b) : r(_r), g(_g), b(_b) {}
+    explicit Radiance(const Color& c) : r(c.x()), g(c.y()), b(c.z()) {}
+
+    inline Radiance& operator +=(const Radiance& c) {r += c.r; g += c.g; b += c.b; return *this;}
+    inline Radiance operator +(const Radiance& c) const {return Radiance(r + c.r, g + c.g, b + c.b);}
+    inline Radiance operator *(float s) const {return Radiance(r * s, g * s, b * s);}
+    inline Radiance operator /(float s) const {return Radiance(r / s, g / s, b / s);}
+
+    inline Color color() const {return Color(r, g, b);}
+};
+
+static_assert(sizeof(Radiance) == 3 * sizeof(float), "quantizeImage reads Radiance as a float array");
+
+// Value an output pixel shows for one channel, before truncation
+inline float displayed(float v) {return std::min(255.0f, std::max(0.0f, v));}
+
+inline unsigned char quantize(float v) {return static_cast<unsigned char>(displayed(v));}
+
+// Clamps and truncates count pixels to 8 bit RGB triplets in one branch-free pass
+// over the channels, which the compiler turns into SIMD min/max and conversions
+inline void quantizeImage(const Radiance* pixels, size_t count, unsigned char* __restrict out) {
+    const float* __restrict channels = &pixels[0].r;
+    const size_t n = count * 3;
+    size_t i = 0;
+    // Fixed width blocks vectorize at -O2, the tail is done one channel at a time
+    for(; i + 16 <= n; i += 16) {
+        for(size_t k = 0; k < 16; ++k) {
+            out[i + k] = static_cast<unsigned char>(static_cast<int>(displayed(channels[i + k])));
+        }
+    }
+    for(; i < n; ++i) {
+        out[i] = static_cast<unsigned char>(static_cast<int>(displayed(channels[i])));
+    }
+}
+
+#endif
@@ -0,0 +1,8 @@
+#include <random>
+#include "Random.h"
+
+double generate_random_double() {
+    thread_local std::mt19937 gen(std::random_device{}());
+    thread_local std::uniform_real_distribution<> dis(0.0, 1.0);
+    return dis(gen);
+}
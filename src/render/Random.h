@@ -0,0 +1,7 @@
+#ifndef _RANDOM_H
+#define _RANDOM_H
+
+// Uniform double in [0, 1), every thread has its own generator
+double generate_random_double();
+
+#endif
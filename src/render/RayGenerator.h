@@ -0,0 +1,36 @@
+#ifndef _RAYGENERATOR_H
+#define _RAYGENERATOR_H
+
+#include "../Ray.h"
+#include "../scene/Camera.h"
+
+// Camera basis computed once per camera, turns image positions into primary rays
+class RayGenerator {
+public:
+    RayGenerator(const Camera& camera) : camera(camera) {
+        w = camera.gaze;
+        u = (camera.up * w).normalize();
+        v = w * u;
+
+        double aspect_ratio = static_cast<double>(camera.h_res) / camera.v_res;
+        image_plane_width = camera.right - camera.left;
+        image_plane_height = (camera.top - camera.bottom) / aspect_ratio;
+    }
+
+    // Ray through image position (x, y), pixel (i, j) covers [i, i + 1) x [j, j + 1)
+    inline Ray at(double x, double y) const {
+        double u_offset = x * image_plane_width / camera.h_res;
+        double v_offset = y * image_plane_height / camera.v_res;
+        Point pixel_pos = camera.position + (w * camera.near_distance) + (u * (camera.left + u_offset)) + (v * (camera.bottom + v_offset));
+        return Ray(camera.position, (pixel_pos - camera.position).normalize());
+    }
+
+    inline const Camera& getCamera() const {return camera;}
+
+private:
+    const Camera& camera;
+    Vector w, u, v;
+    double image_plane_width, image_plane_height;
+};
+
+#endif
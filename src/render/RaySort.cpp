@@ -0,0 +1,82 @@
+#include <cmath>
+#include <array>
+
+#include "RaySort.h"
+
+bool parseRaySortMode(const std::string& name, RaySortMode& mode) {
+    if(name == "off") {
+        mode = RaySortMode::Off;
+    }
+    else if(name == "on") {
+        mode = RaySortMode::On;
+    }
+    else if(name == "auto") {
+        mode = RaySortMode::Auto;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string raySortModeName(RaySortMode mode) {
+    switch(mode) {
+        case RaySortMode::On: return "on";
+        case RaySortMode::Auto: return "auto";
+        default: return "off";
+    }
+}
+
+// Bit i of a 7 bit value moved to bit 6 * i, one entry per value
+static const std::array<uint64_t, 128>& spreadTable() {
+    static const std::array<uint64_t, 128> table = [] {
+        std::array<uint64_t, 128> t{};
+        for(uint32_t x = 0; x < 128; ++x) {
+            for(int bit = 0; bit < 7; ++bit) {
+                t[x] |= static_cast<uint64_t>((x >> bit) & 1) << (6 * bit);
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Maps v in [min, max] to 0..127
+static uint32_t quantize7(double v, double min, double max) {
+    double extent = max - min;
+    double unit = extent > 0 ? (v - min) / extent : 0;
+    return static_cast<uint32_t>(std::clamp(unit, 0.0, 1.0) * 127);
+}
+
+uint64_t raySortKey(const Ray& ray, const AABB& bounds) {
+    const std::array<uint64_t, 128>& spread = spreadTable();
+    const Point origin = ray.origin();
+    const Vector dir = ray.direction();
+
+    uint64_t octant = (dir.x() < 0 ? 1 : 0) | (dir.y() < 0 ? 2 : 0) | (dir.z() < 0 ? 4 : 0);
+    uint64_t key = 0;
+    for(int axis = 0; axis < 3; ++axis) {
+        key |= spread[quantize7(origin.e[axis], bounds.min.e[axis], bounds.max.e[axis])] << (5 - axis);
+        key |= spread[quantize7(dir.e[axis], -1, 1)] << (2 - axis);
+    }
+    return octant << (6 * 7) | key;
+}
+
+void radixSortKeys(std::vector<std::pair<uint64_t, uint32_t>>& keys) {
+    thread_local std::vector<std::pair<uint64_t, uint32_t>> temp;
+    temp.resize(keys.size());
+
+    for(int shift = 0; shift < RAY_SORT_KEY_BITS; shift += 8) {
+        size_t counts[257] = {0};
+        for(const auto& key : keys) {
+            counts[((key.first >> shift) & 0xff) + 1]++;
+        }
+        for(int digit = 0; digit < 256; ++digit) {
+            counts[digit + 1] += counts[digit];
+        }
+        for(const auto& key : keys) {
+            temp[counts[(key.first >> shift) & 0xff]++] = key;
+        }
+        std::swap(keys, temp);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _RAYSORT_H
+#define _RAYSORT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "../Ray.h"
+#include "../accel/AABB.h"
+
+// Whether the wavefront renderer sorts its reflection and shadow queues before traversal
+enum class RaySortMode {
+    Off,
+    On,
+    Auto    // Time a few batches each way, then keep whichever traverses faster
+};
+
+bool parseRaySortMode(const std::string& name, RaySortMode& mode);
+std::string raySortModeName(RaySortMode mode);
+
+// Bits of a sort key, the direction octant above a 6D Morton code of the origin (quantized
+// to 7 bits per axis inside bounds) and the direction. Rays with close keys start close
+// together and point the same way, so they visit the same BVH nodes.
+static const int RAY_SORT_KEY_BITS = 3 + 6 * 7;
+
+uint64_t raySortKey(const Ray& ray, const AABB& bounds);
+
+// Stable LSD radix sort of (key, index) pairs by the low RAY_SORT_KEY_BITS of the key
+void radixSortKeys(std::vector<std::pair<uint64_t, uint32_t>>& keys);
+
+// Reorders items (anything with a ray member) by raySortKey over the bounds of their origins.
+// keys is scratch space kept by the caller between calls.
+template <typename T>
+void sortRays(std::vector<T>& items, std::vector<std::pair<uint64_t, uint32_t>>& keys, std::vector<T>& scratch) {
+    if(items.size() < 2) {
+        return;
+    }
+    AABB bounds;
+    for(const T& item : items) {
+        bounds.expand(item.ray.origin());
+    }
+
+    keys.resize(items.size());
+    for(size_t i = 0; i < items.size(); ++i) {
+        keys[i] = {raySortKey(items[i].ray, bounds), static_cast<uint32_t>(i)};
+    }
+    radixSortKeys(keys);
+
+    scratch.resize(items.size());
+    for(size_t i = 0; i < keys.size(); ++i) {
+        scratch[i] = items[keys[i].second];
+    }
+    std::swap(items, scratch);
+}
+
+#endif
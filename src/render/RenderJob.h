@@ -0,0 +1,25 @@
+#ifndef _RENDERJOB_H
+#define _RENDERJOB_H
+
+#include <vector>
+#include <atomic>
+
+#include "Tile.h"
+#include "Framebuffer.h"
+#include "../RGB.h"
+#include "../scene/Camera.h"
+
+// Everything needed to render and write the image of one camera.
+// Tiles of all jobs share the pool queue, the job is written once its last tile is done.
+struct RenderJob {
+    RenderJob(const Camera& camera, TileOrder order, int tile_size = TILE_SIZE) : camera(camera), buffer(camera.h_res, camera.v_res, tile_size), tiles(makeTiles(camera.region(), order, tile_size)), remaining_tiles(tiles.size()) {}
+
+    const Camera& camera;
+    Framebuffer buffer;
+    std::vector<Tile> tiles;
+    std::atomic<int> remaining_tiles;
+    // Samples taken per pixel (row-major), only kept for adaptive sampling
+    std::vector<unsigned short> sample_counts;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _RENDERSTATS_H
+#define _RENDERSTATS_H
+
+// Counters kept per thread while rendering, published to Progress once per tile
+struct RenderStats {
+    long long samples = 0;
+    long long primary_rays = 0;
+    long long shadow_rays = 0;
+    long long reflection_rays = 0;
+    long long shadow_cache_lookups = 0;
+    long long shadow_cache_hits = 0;
+
+    inline long long rays() const {return primary_rays + shadow_rays + reflection_rays;}
+
+    inline RenderStats operator -(const RenderStats& s) const {
+        RenderStats d;
+        d.samples = samples - s.samples;
+        d.primary_rays = primary_rays - s.primary_rays;
+        d.shadow_rays = shadow_rays - s.shadow_rays;
+        d.reflection_rays = reflection_rays - s.reflection_rays;
+        d.shadow_cache_lookups = shadow_cache_lookups - s.shadow_cache_lookups;
+        d.shadow_cache_hits = shadow_cache_hits - s.shadow_cache_hits;
+        return d;
+    }
+};
+
+// Totals of one finished render
+struct RenderSummary {
+    double seconds = 0;
+    RenderStats stats;
+};
+
+// Counters of the calling thread
+inline RenderStats& localStats() {
+    thread_local RenderStats stats;
+    return stats;
+}
+
+#endif
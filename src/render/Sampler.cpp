@@ -0,0 +1,230 @@
+#include <cmath>
+#include <cstdint>
+
+#include "Sampler.h"
+#include "Random.h"
+
+bool parseSamplerType(const std::string& name, SamplerType& type) {
+    if(name == "random") {
+        type = SamplerType::Random;
+    }
+    else if(name == "stratified") {
+        type = SamplerType::Stratified;
+    }
+    else if(name == "sobol") {
+        type = SamplerType::Sobol;
+    }
+    else if(name == "halton") {
+        type = SamplerType::Halton;
+    }
+    else if(name == "r2") {
+        type = SamplerType::R2;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string samplerTypeName(SamplerType type) {
+    switch(type) {
+        case SamplerType::Stratified: return "stratified";
+        case SamplerType::Sobol: return "sobol";
+        case SamplerType::Halton: return "halton";
+        case SamplerType::R2: return "r2";
+        default: return "random";
+    }
+}
+
+// Avalanching integer hash, decorrelates pixels without any per-pixel state
+static uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t pixelSeed(int x, int y, uint32_t salt) {
+    return hash(static_cast<uint32_t>(x) ^ hash(static_cast<uint32_t>(y) ^ hash(salt)));
+}
+
+// Maps 32 random bits to [0, 1)
+static double toUnit(uint32_t bits) {
+    return bits * (1.0 / 4294967296.0);
+}
+
+static uint32_t reverseBits(uint32_t x) {
+    x = ((x & 0x55555555u) << 1) | ((x >> 1) & 0x55555555u);
+    x = ((x & 0x33333333u) << 2) | ((x >> 2) & 0x33333333u);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x >> 4) & 0x0f0f0f0fu);
+    x = ((x & 0x00ff00ffu) << 8) | ((x >> 8) & 0x00ff00ffu);
+    return (x << 16) | (x >> 16);
+}
+
+// Hash based Owen scrambling (Laine-Karras permutation on reversed bits): every bit is
+// flipped depending only on the bits above it, which keeps the net properties intact
+static uint32_t owenScramble(uint32_t x, uint32_t seed) {
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+// Random permutation of [0, n) evaluated one element at a time (Kensler, "Correlated Multi-Jittered Sampling")
+static uint32_t permute(uint32_t i, uint32_t n, uint32_t seed) {
+    uint32_t w = n - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= seed;
+        i *= 0xe170893du;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3fu;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while(i >= n);
+    return (i + seed) % n;
+}
+
+static double radicalInverse(uint32_t index, uint32_t base) {
+    double inv_base = 1.0 / base;
+    double scale = inv_base;
+    double result = 0;
+    while(index > 0) {
+        result += (index % base) * scale;
+        index /= base;
+        scale *= inv_base;
+    }
+    return result;
+}
+
+// Cranley-Patterson rotation
+static double rotate(double value, uint32_t shift) {
+    value += toUnit(shift);
+    return value >= 1.0 ? value - 1.0 : value;
+}
+
+// Independent uniform offsets, the original behaviour
+class RandomSampler : public Sampler {
+public:
+    void sample(int, int, int, int, double& u, double& v) const override {
+        u = generate_random_double();
+        v = generate_random_double();
+    }
+};
+
+// Jittered grid when the batch size is a square, otherwise jittered N-rooks
+// (one sample per row and per column of a count x count grid)
+class StratifiedSampler : public Sampler {
+public:
+    void sample(int x, int y, int index, int count, double& u, double& v) const override {
+        if(count <= 1) {
+            u = generate_random_double();
+            v = generate_random_double();
+            return;
+        }
+        int stratum = index % count;
+        // Every batch gets its own permutation
+        uint32_t seed = pixelSeed(x, y, index / count);
+
+        int side = static_cast<int>(std::sqrt(static_cast<double>(count)) + 0.5);
+        if(side * side == count) {
+            int cell = permute(stratum, count, seed);
+            u = (cell % side + generate_random_double()) / side;
+            v = (cell / side + generate_random_double()) / side;
+        }
+        else {
+            u = (stratum + generate_random_double()) / count;
+            v = (permute(stratum, count, seed) + generate_random_double()) / count;
+        }
+    }
+};
+
+// First two Sobol dimensions with per-pixel Owen scrambling and index shuffling
+class SobolSampler : public Sampler {
+public:
+    SobolSampler() {
+        // Second dimension, primitive polynomial x + 1
+        directions[0] = 1u << 31;
+        for(int i = 1; i < 32; ++i) {
+            directions[i] = directions[i - 1] ^ (directions[i - 1] >> 1);
+        }
+    }
+
+    void sample(int x, int y, int index, int, double& u, double& v) const override {
+        uint32_t seed = pixelSeed(x, y, 0);
+        uint32_t i = owenScramble(index, seed);
+
+        uint32_t second = 0;
+        for(int bit = 0; bit < 32; ++bit) {
+            if((i >> bit) & 1) {
+                second ^= directions[bit];
+            }
+        }
+        u = toUnit(owenScramble(reverseBits(i), hash(seed ^ 0x1u)));
+        v = toUnit(owenScramble(second, hash(seed ^ 0x2u)));
+    }
+
+private:
+    uint32_t directions[32];
+};
+
+// Radical inverse in bases 2 and 3, rotated per pixel
+class HaltonSampler : public Sampler {
+public:
+    void sample(int x, int y, int index, int, double& u, double& v) const override {
+        uint32_t seed = pixelSeed(x, y, 0);
+        u = rotate(radicalInverse(index, 2), hash(seed ^ 0x1u));
+        v = rotate(radicalInverse(index, 3), hash(seed ^ 0x2u));
+    }
+};
+
+// Additive recurrence on the plastic number (Roberts' R2 sequence), rotated per pixel
+class R2Sampler : public Sampler {
+public:
+    void sample(int x, int y, int index, int, double& u, double& v) const override {
+        static const double g = 1.32471795724474602596;
+        static const double a1 = 1.0 / g;
+        static const double a2 = 1.0 / (g * g);
+
+        uint32_t seed = pixelSeed(x, y, 0);
+        u = rotate(std::fmod(0.5 + a1 * index, 1.0), hash(seed ^ 0x1u));
+        v = rotate(std::fmod(0.5 + a2 * index, 1.0), hash(seed ^ 0x2u));
+    }
+};
+
+const Sampler& getSampler(SamplerType type) {
+    static const RandomSampler random;
+    static const StratifiedSampler stratified;
+    static const SobolSampler sobol;
+    static const HaltonSampler halton;
+    static const R2Sampler r2;
+
+    switch(type) {
+        case SamplerType::Stratified: return stratified;
+        case SamplerType::Sobol: return sobol;
+        case SamplerType::Halton: return halton;
+        case SamplerType::R2: return r2;
+        default: return random;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef _SAMPLER_H
+#define _SAMPLER_H
+
+#include <string>
+
+// How anti aliasing positions inside a pixel are chosen
+enum class SamplerType {
+    Random,
+    Stratified,
+    Sobol,
+    Halton,
+    R2
+};
+
+bool parseSamplerType(const std::string& name, SamplerType& type);
+std::string samplerTypeName(SamplerType type);
+
+// Produces 2D offsets in [0, 1) inside a pixel.
+// Samplers are stateless, any thread may call them for any pixel. Sample `index` is the
+// running sample number of the pixel, `count` the size of the batch it belongs to, so
+// a progressive renderer can keep asking for more.
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+    virtual void sample(int x, int y, int index, int count, double& u, double& v) const = 0;
+};
+
+// Shared instance of the given sampler
+const Sampler& getSampler(SamplerType type);
+
+#endif
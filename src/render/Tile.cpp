@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cstdint>
+#include "Tile.h"
+
+bool parseTileOrder(const std::string& name, TileOrder& order) {
+    if(name == "scanline") {
+        order = TileOrder::Scanline;
+    }
+    else if(name == "morton") {
+        order = TileOrder::Morton;
+    }
+    else if(name == "hilbert") {
+        order = TileOrder::Hilbert;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::string tileOrderName(TileOrder order) {
+    switch(order) {
+        case TileOrder::Morton: return "morton";
+        case TileOrder::Hilbert: return "hilbert";
+        default: return "scanline";
+    }
+}
+
+// Interleaves the bits of x and y (x in the even bits)
+static uint64_t mortonCode(uint32_t x, uint32_t y) {
+    auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// Distance of (x, y) along the Hilbert curve filling an n x n grid, n a power of two
+static uint64_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for(uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant
+        if(ry == 0) {
+            if(rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+static uint32_t nextPowerOfTwo(uint32_t v) {
+    uint32_t n = 1;
+    while(n < v) {
+        n *= 2;
+    }
+    return n;
+}
+
+// Sorts grid cells (x, y) of a w x h grid along the curve, returns their indices in order
+static std::vector<std::pair<int, int>> curveOrder(int w, int h, TileOrder order) {
+    std::vector<std::pair<int, int>> cells;
+    for(int y = 0; y < h; ++y) {
+        for(int x = 0; x < w; ++x) {
+            cells.push_back({x, y});
+        }
+    }
+    if(order == TileOrder::Scanline) {
+        return cells;
+    }
+
+    uint32_t n = nextPowerOfTwo(std::max(w, h));
+    auto key = [&](const std::pair<int, int>& c) {
+        return order == TileOrder::Morton ? mortonCode(c.first, c.second) : hilbertIndex(n, c.first, c.second);
+    };
+    std::stable_sort(cells.begin(), cells.end(), [&](const auto& a, const auto& b) { return key(a) < key(b); });
+    return cells;
+}
+
+std::vector<Tile> makeTiles(int width, int height, TileOrder order, int tile_size) {
+    return makeTiles(Tile{0, 0, width, height}, order, tile_size);
+}
+
+std::vector<Tile> makeTiles(const Tile& region, TileOrder order, int tile_size) {
+    // Tiles sit on the image's tile grid, the same one Framebuffer stores pixels in,
+    // so every tile first-touches only its own block. The first and last row and
+    // column are clipped to the region.
+    int first_x = region.x0 / tile_size;
+    int first_y = region.y0 / tile_size;
+    int tiles_x = (region.x1 + tile_size - 1) / tile_size - first_x;
+    int tiles_y = (region.y1 + tile_size - 1) / tile_size - first_y;
+
+    std::vector<Tile> tiles;
+    for(const auto& [tx, ty] : curveOrder(tiles_x, tiles_y, order)) {
+        int x = (first_x + tx) * tile_size;
+        int y = (first_y + ty) * tile_size;
+        tiles.push_back(Tile{std::max(x, region.x0), std::max(y, region.y0), std::min(x + tile_size, region.x1), std::min(y + tile_size, region.y1)});
+    }
+    return tiles;
+}
+
+const std::vector<std::pair<int, int>>& tilePixelOrder(TileOrder order) {
+    static const std::vector<std::pair<int, int>> orders[] = {
+        curveOrder(TILE_SIZE, TILE_SIZE, TileOrder::Scanline),
+        curveOrder(TILE_SIZE, TILE_SIZE, TileOrder::Morton),
+        curveOrder(TILE_SIZE, TILE_SIZE, TileOrder::Hilbert)
+    };
+    return orders[static_cast<int>(order)];
+}
@@ -0,0 +1,40 @@
+#ifndef _TILE_H
+#define _TILE_H
+
+#include <vector>
+#include <string>
+#include <utility>
+
+static const int TILE_SIZE = 32;
+
+// Rectangle of pixels [x0, x1) x [y0, y1) rendered as one task
+struct Tile {
+    int x0, y0, x1, y1;
+
+    inline int width() const {return x1 - x0;}
+    inline int height() const {return y1 - y0;}
+    inline int pixelCount() const {return width() * height();}
+
+    bool operator==(const Tile&) const = default;
+};
+
+// Order in which tiles are issued and pixels inside a tile are traced.
+// Space filling curves keep consecutive rays close together in the scene.
+enum class TileOrder {
+    Scanline,
+    Morton,
+    Hilbert
+};
+
+bool parseTileOrder(const std::string& name, TileOrder& order);
+std::string tileOrderName(TileOrder order);
+
+std::vector<Tile> makeTiles(int width, int height, TileOrder order = TileOrder::Scanline, int tile_size = TILE_SIZE);
+// Tiles covering only the given region of the image, on the same grid as the whole image
+std::vector<Tile> makeTiles(const Tile& region, TileOrder order = TileOrder::Scanline, int tile_size = TILE_SIZE);
+
+// (dx, dy) offsets covering a TILE_SIZE x TILE_SIZE block in the given order.
+// Offsets that fall outside a smaller edge tile have to be skipped by the caller.
+const std::vector<std::pair<int, int>>& tilePixelOrder(TileOrder order);
+
+#endif
@@ -0,0 +1,325 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+
+#include "WavefrontRenderer.h"
+#include "RenderJob.h"
+#include "RenderStats.h"
+#include "ImageWriter.h"
+#include "Sampler.h"
+#include "Random.h"
+#include "../ThreadPool.h"
+#include "../Topology.h"
+#include "../Progress.h"
+
+using std::cout;
+
+typedef std::chrono::steady_clock Clock;
+
+static long long nanosecondsSince(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+WavefrontRenderer::WavefrontRenderer(SceneBuilder& builder)
+    : builder(builder), sort_ns(0), traversal_ns{0, 0}, traversal_rays{0, 0}, batches_started(0), trial_batches_done(0), sort_decision(-1) {
+}
+
+double WavefrontRenderer::SortStats::nsPerRay(bool sorted) const {
+    long long ns = traversal_ns[sorted] + (sorted ? sort_ns : 0);
+    return rays[sorted] > 0 ? static_cast<double>(ns) / rays[sorted] : 0;
+}
+
+WavefrontRenderer::SortStats WavefrontRenderer::sortStats() const {
+    SortStats stats;
+    stats.sort_ns = sort_ns.load();
+    for(int sorted = 0; sorted < 2; ++sorted) {
+        stats.traversal_ns[sorted] = traversal_ns[sorted].load();
+        stats.rays[sorted] = traversal_rays[sorted].load();
+    }
+    switch(builder.getOptions().ray_sort) {
+        case RaySortMode::On: stats.sorting = true; break;
+        case RaySortMode::Off: stats.sorting = false; break;
+        default: stats.sorting = sort_decision.load() == 1;
+    }
+    return stats;
+}
+
+bool WavefrontRenderer::sortNextBatch() {
+    switch(builder.getOptions().ray_sort) {
+        case RaySortMode::On: return true;
+        case RaySortMode::Off: return false;
+        default: break;
+    }
+    int decision = sort_decision.load();
+    if(decision >= 0) {
+        return decision == 1;
+    }
+    // Alternate until enough batches of both kinds are timed
+    return batches_started++ % 2 == 1;
+}
+
+void WavefrontRenderer::decideSorting() {
+    SortStats stats = sortStats();
+    // Without secondary rays sorting has nothing to gain
+    int decision = stats.rays[0] > 0 && stats.rays[1] > 0 && stats.nsPerRay(true) < stats.nsPerRay(false) ? 1 : 0;
+    int undecided = -1;
+    sort_decision.compare_exchange_strong(undecided, decision);
+}
+
+int WavefrontRenderer::batchSize() const {
+    // Every sample holds a path in both path queues, a hit and its radiance, and on
+    // average about one shadow ray. Half of L2 is left for the BVH and the scene.
+    const size_t sample_bytes = 2 * sizeof(Path) + sizeof(Hit) + sizeof(Color) + sizeof(ShadowRay);
+    const size_t budget = CpuTopology::get().l2CacheBytes() / 2;
+    size_t pixels = budget / (sample_bytes * std::max(1, builder.getAntiAliasing()));
+    int size = static_cast<int>(std::sqrt(static_cast<double>(pixels)));
+    return std::clamp(size, 4, 64);
+}
+
+RenderSummary WavefrontRenderer::renderScene(bool write_images) {
+    const RenderOptions& options = builder.getOptions();
+    if(options.replicate_geometry && builder.replicas.empty()) {
+        builder.replicateGeometry();
+    }
+
+    const int batch_size = batchSize();
+    std::vector<std::unique_ptr<RenderJob>> jobs;
+    long long total_pixels = 0;
+    for(const auto& camera : builder.getScene().cameras) {
+        jobs.push_back(std::make_unique<RenderJob>(camera, options.tile_order, batch_size));
+        total_pixels += camera.region().pixelCount();
+    }
+
+    Progress progress(total_pixels, options.quiet);
+
+    TaskGroup tasks;
+    for(auto& job : jobs) {
+        for(const auto& tile : job->tiles) {
+            tasks.run([&, job = job.get()]() {
+                renderTask(job->camera, tile, job->buffer, progress);
+
+                if(--job->remaining_tiles == 0) {
+                    if(write_images) {
+                        writeImage(job->camera, job->buffer);
+                    }
+                    job->buffer.release();
+                }
+            });
+        }
+    }
+
+    tasks.wait();
+    progress.finish();
+
+    // Too few batches to finish the trial, decide on what was timed
+    if(options.ray_sort == RaySortMode::Auto && sort_decision.load() < 0) {
+        decideSorting();
+    }
+
+    SortStats sort_stats = sortStats();
+    if(!options.quiet && options.ray_sort != RaySortMode::Off && sort_stats.rays[0] + sort_stats.rays[1] > 0) {
+        cout << "Ray sorting (" << raySortModeName(options.ray_sort) << "): " << std::fixed << std::setprecision(1);
+        if(sort_stats.rays[1] > 0) {
+            cout << sort_stats.sort_ns / 1e6 << " ms sorting, " << sort_stats.nsPerRay(true) << " ns per sorted ray";
+        }
+        if(sort_stats.rays[0] > 0) {
+            cout << (sort_stats.rays[1] > 0 ? " vs " : "") << sort_stats.nsPerRay(false) << " ns per unsorted ray";
+        }
+        cout << ", sorting " << (sort_stats.sorting ? "on" : "off") << "\n" << std::defaultfloat;
+    }
+
+    return RenderSummary{progress.elapsedSeconds(), progress.stats()};
+}
+
+void WavefrontRenderer::renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress) {
+    const int batch_size = batchSize();
+    Framebuffer buffer(camera.h_res, camera.v_res);
+
+    TaskGroup tasks;
+    for(const auto& tile : tiles) {
+        for(int y = tile.y0; y < tile.y1; y += batch_size) {
+            for(int x = tile.x0; x < tile.x1; x += batch_size) {
+                Tile batch{x, y, std::min(x + batch_size, tile.x1), std::min(y + batch_size, tile.y1)};
+                tasks.run([&, batch]() {
+                    renderTask(camera, batch, buffer, progress);
+                });
+            }
+        }
+    }
+    tasks.wait();
+
+    pixels.clear();
+    for(const auto& tile : tiles) {
+        for(int j = tile.y0; j < tile.y1; ++j) {
+            for(int i = tile.x0; i < tile.x1; ++i) {
+                pixels.push_back(buffer.get(i, j));
+            }
+        }
+    }
+}
+
+void WavefrontRenderer::renderTask(const Camera& camera, const Tile& tile, Framebuffer& buffer, Progress& progress) {
+    thread_local Queues queues;
+    RenderStats& stats = localStats();
+    RenderStats before = stats;
+
+    RayGenerator rays(camera);
+    bool timing = builder.getOptions().ray_sort == RaySortMode::Auto && sort_decision.load() < 0;
+    renderBatch(rays, tile, buffer, queues, sortNextBatch());
+    progress.add(tile.pixelCount(), stats - before);
+    if(timing && ++trial_batches_done == SORT_TRIAL_BATCHES) {
+        decideSorting();
+    }
+}
+
+void WavefrontRenderer::renderBatch(const RayGenerator& rays, const Tile& tile, Framebuffer& buffer, Queues& queues, bool sort) {
+    generate(rays, tile, queues);
+    bool primary = true;
+    while(!queues.paths.empty()) {
+        // Camera rays are coherent already, reflection rays are timed and maybe sorted
+        if(primary) {
+            intersect(queues);
+        }
+        else {
+            Clock::time_point start = Clock::now();
+            if(sort) {
+                sortRays(queues.paths, queues.keys, queues.path_scratch);
+                sort_ns += nanosecondsSince(start);
+                start = Clock::now();
+            }
+            intersect(queues);
+            traversal_ns[sort] += nanosecondsSince(start);
+            traversal_rays[sort] += queues.paths.size();
+        }
+        primary = false;
+
+        shade(queues);
+
+        Clock::time_point start = Clock::now();
+        if(sort) {
+            sortRays(queues.shadows, queues.keys, queues.shadow_scratch);
+            sort_ns += nanosecondsSince(start);
+            start = Clock::now();
+        }
+        traceShadows(queues);
+        traversal_ns[sort] += nanosecondsSince(start);
+        traversal_rays[sort] += queues.shadows.size();
+
+        // shade appended only the paths that go on, the queue stays dense
+        std::swap(queues.paths, queues.next_paths);
+    }
+
+    const int count = builder.getAntiAliasing();
+    for(int j = tile.y0; j < tile.y1; ++j) {
+        for(int i = tile.x0; i < tile.x1; ++i) {
+            size_t first = (static_cast<size_t>(j - tile.y0) * tile.width() + (i - tile.x0)) * count;
+            Color sum(0, 0, 0);
+            for(int k = 0; k < count; ++k) {
+                sum += queues.radiance[first + k];
+            }
+            buffer.set(i, j, Radiance(sum / count));
+        }
+    }
+}
+
+void WavefrontRenderer::generate(const RayGenerator& rays, const Tile& tile, Queues& queues) const {
+    const Sampler& sampler = getSampler(builder.getOptions().sampler);
+    const int count = builder.getAntiAliasing();
+
+    queues.paths.clear();
+    for(int j = tile.y0; j < tile.y1; ++j) {
+        for(int i = tile.x0; i < tile.x1; ++i) {
+            for(int k = 0; k < count; ++k) {
+                double u, v;
+                sampler.sample(i, j, k, count, u, v);
+                int sample = static_cast<int>(queues.paths.size());
+                queues.paths.push_back(Path{rays.at(i + u, j + v), Color(1, 1, 1), sample, 0});
+            }
+        }
+    }
+    queues.radiance.assign(queues.paths.size(), Color(0, 0, 0));
+    if(builder.getOptions().count_rays) {
+        localStats().samples += queues.paths.size();
+    }
+}
+
+void WavefrontRenderer::intersect(Queues& queues) const {
+    queues.hits.resize(queues.paths.size());
+    for(size_t p = 0; p < queues.paths.size(); ++p) {
+        builder.intersect(queues.paths[p].ray, queues.hits[p]);
+    }
+
+    // A queue holds either camera rays or reflection rays of one bounce
+    if(builder.getOptions().count_rays && !queues.paths.empty()) {
+        RenderStats& stats = localStats();
+        (queues.paths[0].depth == 0 ? stats.primary_rays : stats.reflection_rays) += queues.paths.size();
+    }
+}
+
+void WavefrontRenderer::shade(Queues& queues) const {
+    const Scene& scene = builder.getScene();
+    const RenderOptions& options = builder.getOptions();
+    const Color ambient_light(scene.ambient_light.r, scene.ambient_light.g, scene.ambient_light.b);
+    const Color background = builder.background().color();
+
+    queues.next_paths.clear();
+    queues.shadows.clear();
+    for(size_t p = 0; p < queues.paths.size(); ++p) {
+        const Path& path = queues.paths[p];
+        Hit& hit = queues.hits[p];
+        Color& radiance = queues.radiance[path.sample];
+        if(!hit.is_hit()) {
+            radiance += path.throughput.multiply(background);
+            continue;
+        }
+
+        radiance += path.throughput.multiply(hit.material.ambient.multiply(ambient_light));
+
+        // Direct lighting is only queued, the shadow kernel adds what is not blocked
+        builder.shadingLights(hit.hit_point, queues.lights);
+        for(const auto& [l, weight] : queues.lights) {
+            const PointLight& light = scene.lights[l];
+            Color contribution = path.throughput.multiply(builder.shade(path.ray, hit, light) * weight);
+            if(contribution.x() <= 0 && contribution.y() <= 0 && contribution.z() <= 0) {
+                continue;
+            }
+            Vector light_direction = light.position - hit.hit_point;
+            double distance_to_light = light_direction.length();
+            light_direction = light_direction.normalize();
+            Ray shadow_ray(hit.hit_point + light_direction * 1e-4, light_direction);
+            queues.shadows.push_back(ShadowRay{shadow_ray, distance_to_light, contribution, path.sample, l});
+        }
+
+        // Same termination as SceneBuilder::shadeHit
+        const Color& mirror = hit.material.mirror_reflectance;
+        if(path.depth < static_cast<int>(scene.max_raytracedepth) && (mirror.x() > 0 || mirror.y() > 0 || mirror.z() > 0)) {
+            Color throughput = path.throughput.multiply(mirror);
+            double contribution = std::max(throughput.x(), std::max(throughput.y(), throughput.z()));
+            if(contribution < options.reflection_cutoff) {
+                double survive = contribution / options.reflection_cutoff;
+                if(!options.russian_roulette || generate_random_double() >= survive) {
+                    continue;
+                }
+                throughput = throughput / survive;
+            }
+
+            Vector reflect_dir = path.ray.direction() - hit.normal * 2.0 * path.ray.direction().dot(hit.normal);
+            reflect_dir = reflect_dir.normalize();
+            queues.next_paths.push_back(Path{Ray(hit.hit_point + reflect_dir * 1e-4, reflect_dir), throughput, path.sample, path.depth + 1});
+        }
+    }
+}
+
+void WavefrontRenderer::traceShadows(Queues& queues) const {
+    if(builder.getOptions().count_rays) {
+        localStats().shadow_rays += queues.shadows.size();
+    }
+    for(const ShadowRay& shadow : queues.shadows) {
+        if(!builder.occluded(shadow.ray, shadow.max_distance, shadow.light)) {
+            queues.radiance[shadow.sample] += shadow.contribution;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef _WAVEFRONTRENDERER_H
+#define _WAVEFRONTRENDERER_H
+
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+
+#include "Tile.h"
+#include "RayGenerator.h"
+#include "RaySort.h"
+#include "../SceneBuilder.h"
+
+// Renders with queues of rays instead of the recursive trace -> shadeHit -> trace chain.
+// Every batch of pixels generates all its camera rays, then runs intersect, shade and
+// shadow kernels over dense queues, one bounce at a time, until no reflection ray is left.
+// Finished paths and zero contributions are dropped between stages, so every kernel
+// loops over live rays only. A batch is sized so its queues stay in the L2 cache.
+// Reflection and shadow queues can be sorted by RaySortMode before they are traversed.
+class WavefrontRenderer {
+public:
+    // Time spent on reflection and shadow rays, [0] for unsorted queues and [1] for sorted ones
+    struct SortStats {
+        long long sort_ns = 0;
+        long long traversal_ns[2] = {0, 0};
+        long long rays[2] = {0, 0};
+        bool sorting = false;   // What auto mode settled on, or the fixed mode
+
+        // Traversal time per ray, sorting included for sorted queues
+        double nsPerRay(bool sorted) const;
+    };
+
+    explicit WavefrontRenderer(SceneBuilder& builder);
+
+    // Same contract as SceneBuilder::renderScene, uniform anti aliasing only
+    RenderSummary renderScene(bool write_images);
+    // Same contract as SceneBuilder::renderTiles. Tiles larger than a batch are cut into batches.
+    void renderTiles(const Camera& camera, const std::vector<Tile>& tiles, std::vector<Radiance>& pixels, Progress& progress);
+
+    // Edge length of the square pixel batches for the current anti aliasing
+    int batchSize() const;
+
+    SortStats sortStats() const;
+
+private:
+    // A camera or reflection ray and what its radiance is multiplied by on the way to the pixel
+    struct Path {
+        Ray ray;
+        Color throughput;
+        int sample;     // Index into the batch's radiance
+        int depth;
+    };
+
+    // Shadow ray towards a light and what the pixel gains if it is not blocked
+    struct ShadowRay {
+        Ray ray;
+        double max_distance;
+        Color contribution;
+        int sample;
+        int light;
+    };
+
+    // Queues of one batch, reused by the thread between batches
+    struct Queues {
+        std::vector<Path> paths;
+        std::vector<Path> next_paths;
+        std::vector<Hit> hits;
+        std::vector<ShadowRay> shadows;
+        std::vector<Color> radiance;
+        std::vector<std::pair<int, double>> lights;
+        // Sorting scratch
+        std::vector<std::pair<uint64_t, uint32_t>> keys;
+        std::vector<Path> path_scratch;
+        std::vector<ShadowRay> shadow_scratch;
+    };
+
+    // Batches auto mode times before it decides, half of them sorted
+    static const int SORT_TRIAL_BATCHES = 8;
+
+    // Whether the next batch sorts its queues
+    bool sortNextBatch();
+    // Auto mode: sort from now on if sorted rays were cheaper, sorting included
+    void decideSorting();
+
+    // One pool task: renders a batch with the thread's queues and feeds the auto sort trial
+    void renderTask(const Camera& camera, const Tile& tile, Framebuffer& buffer, Progress& progress);
+    void renderBatch(const RayGenerator& rays, const Tile& tile, Framebuffer& buffer, Queues& queues, bool sort);
+
+    // Kernels, each one pass over its queue
+    void generate(const RayGenerator& rays, const Tile& tile, Queues& queues) const;
+    void intersect(Queues& queues) const;
+    void shade(Queues& queues) const;
+    void traceShadows(Queues& queues) const;
+
+    SceneBuilder& builder;
+
+    std::atomic<long long> sort_ns;
+    std::atomic<long long> traversal_ns[2];
+    std::atomic<long long> traversal_rays[2];
+    std::atomic<int> batches_started;
+    std::atomic<int> trial_batches_done;
+    std::atomic<int> sort_decision;     // -1 while auto mode is still timing
+};
+
+#endif
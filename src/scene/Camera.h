@@ -1,7 +1,10 @@
 #ifndef _CAMERA_H
 #define _CAMERA_H
 
+#include <algorithm>
+
 #include "../Vector.h"
+#include "../render/Tile.h"
 
 struct Camera {
     int id;
@@ -12,6 +15,17 @@ struct Camera {
     double near_distance;
     unsigned int h_res, v_res;
     std::string image_name;
+    Tile crop = {0, 0, 0, 0};   // Pixels to trace, empty for the whole image
+    bool crop_fill = false;     // Write a full size image, black outside the crop, instead of the crop only
+
+    // The crop window clamped to the image, or the whole image without one
+    inline Tile region() const {
+        Tile image{0, 0, static_cast<int>(h_res), static_cast<int>(v_res)};
+        if(crop.width() <= 0 || crop.height() <= 0) {
+            return image;
+        }
+        return Tile{std::max(crop.x0, 0), std::max(crop.y0, 0), std::min(crop.x1, image.x1), std::min(crop.y1, image.y1)};
+    }
 };
 
 #endif
\ No newline at end of file
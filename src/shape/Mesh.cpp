@@ -16,15 +16,94 @@ Hit Mesh::intersect(const Ray &ray) const {
     Hit closest_hit;
     closest_hit.t = INF;
 
-    for(const auto& face : faces) {
-        Triangle tri(this->id, face);
-        Hit tri_hit = tri.intersect(ray);
+    auto test_face = [&](int index) {
+        Hit tri_hit = Triangle::intersectFace(faces[index], ray);
         if(tri_hit.t < closest_hit.t) {
             closest_hit = tri_hit;
         }
+        return false;
+    };
+
+    if(face_bvh.empty()) {
+        for(size_t i = 0; i < faces.size(); ++i) {
+            test_face(i);
+        }
+    }
+    else {
+        face_bvh.traverse(ray, closest_hit.t, test_face);
     }
 
     closest_hit.material = this->material;
 
     return closest_hit;
 }
+
+void Mesh::intersectPacket(RayPacket& packet, uint32_t mask, Hit* hits) const {
+    if(face_bvh.empty() || !packet.coherent) {
+        Object::intersectPacket(packet, mask, hits);
+        return;
+    }
+
+    uint32_t updated = 0;
+    face_bvh.traversePacket(packet, mask, [&](int index, uint32_t hit_mask) {
+        for(int r = 0; hit_mask; ++r, hit_mask >>= 1) {
+            if(!(hit_mask & 1)) {
+                continue;
+            }
+            Hit tri_hit = Triangle::intersectFace(faces[index], packet.rays[r]);
+            if(tri_hit.t < hits[r].t) {
+                hits[r] = tri_hit;
+                packet.t_max[r] = tri_hit.t;
+                updated |= 1u << r;
+            }
+        }
+    });
+
+    for(int r = 0; updated; ++r, updated >>= 1) {
+        if(updated & 1) {
+            hits[r].material = this->material;
+        }
+    }
+}
+
+void Mesh::occludePacket(RayPacket& packet, uint32_t mask) const {
+    if(face_bvh.empty() || !packet.coherent) {
+        Object::occludePacket(packet, mask);
+        return;
+    }
+
+    face_bvh.traversePacket(packet, mask, [&](int index, uint32_t hit_mask) {
+        for(int r = 0; hit_mask; ++r, hit_mask >>= 1) {
+            if((hit_mask & 1) && Triangle::intersectFace(faces[index], packet.rays[r]).t < packet.t_max[r]) {
+                packet.active &= ~(1u << r);
+            }
+        }
+    });
+}
+
+void Mesh::build() {
+    std::vector<AABB> boxes;
+    boxes.reserve(faces.size());
+    for(const auto& face : faces) {
+        AABB box;
+        for(const auto& p : face) {
+            box.expand(p);
+        }
+        boxes.push_back(box);
+    }
+    face_bvh.build(boxes);
+}
+
+AABB Mesh::bounds() const {
+    AABB box;
+    for(const auto& face : faces) {
+        for(const auto& p : face) {
+            box.expand(p);
+        }
+    }
+    return box;
+}
+
+Object* Mesh::clone() const {
+    return new Mesh(*this);
+}
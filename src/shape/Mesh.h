@@ -6,6 +6,7 @@
 #include "../Ray.h"
 #include "../Hit.h"
 #include "Object.h"
+#include "../accel/BVH.h"
 
 class Mesh : public Object {
 public:
@@ -13,9 +14,17 @@ public:
     Mesh(int);
 
     std::string getType() const override;
+    Object* clone() const override;
+    AABB bounds() const override;
     virtual Hit intersect(const Ray& ray) const;
+    virtual void intersectPacket(RayPacket& packet, uint32_t mask, Hit* hits) const;
+    virtual void occludePacket(RayPacket& packet, uint32_t mask) const;
+    void build() override;
 
     std::vector<std::array<Point, 3>> faces;
+
+private:
+    BVH face_bvh;
 };
 
 
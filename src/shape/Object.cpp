@@ -4,4 +4,27 @@ Object::Object() {
 }
 
 Object::Object(int id) : id(id) {
-}
\ No newline at end of file
+}
+
+void Object::intersectPacket(RayPacket& packet, uint32_t mask, Hit* hits) const {
+    for(int r = 0; mask; ++r, mask >>= 1) {
+        if(mask & 1) {
+            Hit hit = intersect(packet.rays[r]);
+            if(hit.is_hit() && hit.t < hits[r].t) {
+                hits[r] = hit;
+                packet.t_max[r] = hit.t;
+            }
+        }
+    }
+}
+
+void Object::occludePacket(RayPacket& packet, uint32_t mask) const {
+    for(int r = 0; mask; ++r, mask >>= 1) {
+        if(mask & 1) {
+            Hit hit = intersect(packet.rays[r]);
+            if(hit.is_hit() && hit.t < packet.t_max[r]) {
+                packet.active &= ~(1u << r);
+            }
+        }
+    }
+}
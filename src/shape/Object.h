@@ -4,6 +4,8 @@
 #include <limits>
 #include "../Ray.h"
 #include "../Hit.h"
+#include "../accel/AABB.h"
+#include "../accel/RayPacket.h"
 
 class Object {
 public:
@@ -13,6 +15,17 @@ public:
     virtual ~Object() {}
     virtual Hit intersect(const Ray& ray) const = 0;
     virtual std::string getType() const = 0;
+    virtual Object* clone() const = 0;
+    virtual AABB bounds() const = 0;
+
+    // Packet versions for the rays in mask. intersectPacket updates hits[r] and t_max[r] when
+    // it finds a closer hit, occludePacket clears the active bit of rays blocked before t_max.
+    // The defaults test one ray at a time.
+    virtual void intersectPacket(RayPacket& packet, uint32_t mask, Hit* hits) const;
+    virtual void occludePacket(RayPacket& packet, uint32_t mask) const;
+
+    // Builds acceleration data once parsing is done, runs as its own task
+    virtual void build() {}
 
     int id;
     Material material;
@@ -53,3 +53,12 @@ Hit Sphere::intersect(const Ray &ray) const {
 std::string Sphere::getType() const {
     return "Sphere";
 }
+
+Object* Sphere::clone() const {
+    return new Sphere(*this);
+}
+
+AABB Sphere::bounds() const {
+    Vector r(radius, radius, radius);
+    return AABB(center - r, center + r);
+}
@@ -11,6 +11,8 @@ public:
     Sphere(int id, double _radius) : Object(id), radius(_radius) {}
     virtual Hit intersect(const Ray& ray) const;
     std::string getType() const override;
+    Object* clone() const override;
+    AABB bounds() const override;
 
     Point center;
     double radius;
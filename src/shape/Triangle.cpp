@@ -8,6 +8,12 @@ Triangle::Triangle(int id, const std::array<Point, 3>& c) : Object(id), coords(c
 }
 
 Hit Triangle::intersect(const Ray &ray) const {
+    Hit hit = intersectFace(coords, ray);
+    hit.material = this->material;
+    return hit;
+}
+
+Hit Triangle::intersectFace(const std::array<Point, 3>& coords, const Ray &ray) {
     Hit no_hit;
     no_hit.t = INF;
 
@@ -49,7 +55,6 @@ Hit Triangle::intersect(const Ray &ray) const {
         hit.t = t;
         hit.normal = normal;
         hit.hit_point = ray.origin() + ray.direction() * t;
-        hit.material = this->material;
         return hit;
     }
 
@@ -59,3 +64,15 @@ Hit Triangle::intersect(const Ray &ray) const {
 std::string Triangle::getType() const {
     return "Triangle";
 }
+
+Object* Triangle::clone() const {
+    return new Triangle(*this);
+}
+
+AABB Triangle::bounds() const {
+    AABB box;
+    for(const auto& p : coords) {
+        box.expand(p);
+    }
+    return box;
+}
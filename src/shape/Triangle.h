@@ -11,7 +11,11 @@ public:
     Triangle();
     Triangle(int, const std::array<Point, 3>&);
     virtual Hit intersect(const Ray& ray) const;
+    // Intersection with any face, leaves hit.material unset
+    static Hit intersectFace(const std::array<Point, 3>& coords, const Ray& ray);
     std::string getType() const override;
+    Object* clone() const override;
+    AABB bounds() const override;
     
     std::array<Point, 3> coords;
 };